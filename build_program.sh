@@ -7,6 +7,16 @@ VOTE_PROGRAM_PUBKEY_C_ARRAY="{7,97,72,29,53,116,116,187,124,77,118,36,235,211,18
 CLOCK_SYSVAR_PUBKEY_C_ARRAY="{6,167,213,23,24,199,116,201,40,86,99,152,105,29,94,182,139,94,184,163,155,75,109,92,115,85,91,33,0,0,0,0}"
 SELF_PROGRAM_PUBKEY_C_ARRAY="{13,185,248,61,114,216,45,135,234,80,8,93,228,219,22,126,34,104,192,229,246,81,247,103,239,42,179,169,108,214,218,157}"
 
+# With VAMP_PROFILE=1, program-profile.so is built instead, with compute unit probes compiled in (see PROFILE in
+# entrypoint.c)
+if [ "$VAMP_PROFILE" = "1" ]; then
+    PROFILE_DEFINE=-DVAMP_PROFILE
+    PROGRAM_SO=program-profile.so
+else
+    PROFILE_DEFINE=
+    PROGRAM_SO=program.so
+fi
+
 $SDK_ROOT/bpf/dependencies/bpf-tools/llvm/bin/clang                                       \
     -fno-builtin                                                                          \
     -fno-zero-initialized-in-bss                                                          \
@@ -23,7 +33,8 @@ $SDK_ROOT/bpf/dependencies/bpf-tools/llvm/bin/clang
     -DSYSTEM_PROGRAM_PUBKEY_ARRAY="$SYSTEM_PROGRAM_PUBKEY_C_ARRAY"                        \
     -DVOTE_PROGRAM_PUBKEY_ARRAY="$VOTE_PROGRAM_PUBKEY_C_ARRAY"                            \
     -DCLOCK_SYSVAR_PUBKEY_ARRAY="$CLOCK_SYSVAR_PUBKEY_C_ARRAY"                            \
-    -DSELF_PROGRAM_PUBKEY_ARRAY="$SELF_PROGRAM_PUBKEY_C_ARRAY"
+    -DSELF_PROGRAM_PUBKEY_ARRAY="$SELF_PROGRAM_PUBKEY_C_ARRAY"                            \
+    $PROFILE_DEFINE
 
 $SDK_ROOT/bpf/dependencies/bpf-tools/llvm/bin/ld.lld                                      \
     -z notext                                                                             \
@@ -31,9 +42,9 @@ $SDK_ROOT/bpf/dependencies/bpf-tools/llvm/bin/ld.lld
     --Bdynamic                                                                            \
     $SOURCE_ROOT/program/fixed_bpf.ld                                                     \
     --entry entrypoint                                                                    \
-    -o program.so                                                                         \
+    -o $PROGRAM_SO                                                                        \
     program.po
 
 rm program.po
 
-strip -s -R .comment --strip-unneeded program.so
+strip -s -R .comment --strip-unneeded $PROGRAM_SO
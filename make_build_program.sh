@@ -43,6 +43,16 @@ VOTE_PROGRAM_PUBKEY_C_ARRAY="$VOTE_PROGRAM_PUBKEY_C_ARRAY"
 CLOCK_SYSVAR_PUBKEY_C_ARRAY="$CLOCK_SYSVAR_PUBKEY_C_ARRAY"
 SELF_PROGRAM_PUBKEY_C_ARRAY="$SELF_PROGRAM_PUBKEY_C_ARRAY"
 
+# With VAMP_PROFILE=1, program-profile.so is built instead, with compute unit probes compiled in (see PROFILE in
+# entrypoint.c)
+if [ "\$VAMP_PROFILE" = "1" ]; then
+    PROFILE_DEFINE=-DVAMP_PROFILE
+    PROGRAM_SO=program-profile.so
+else
+    PROFILE_DEFINE=
+    PROGRAM_SO=program.so
+fi
+
 \$SDK_ROOT/bpf/dependencies/bpf-tools/llvm/bin/clang                                       \\
     -fno-builtin                                                                          \\
     -fno-zero-initialized-in-bss                                                          \\
@@ -59,7 +69,8 @@ SELF_PROGRAM_PUBKEY_C_ARRAY="$SELF_PROGRAM_PUBKEY_C_ARRAY"
     -DSYSTEM_PROGRAM_PUBKEY_ARRAY="\$SYSTEM_PROGRAM_PUBKEY_C_ARRAY"                        \\
     -DVOTE_PROGRAM_PUBKEY_ARRAY="\$VOTE_PROGRAM_PUBKEY_C_ARRAY"                            \\
     -DCLOCK_SYSVAR_PUBKEY_ARRAY="\$CLOCK_SYSVAR_PUBKEY_C_ARRAY"                            \\
-    -DSELF_PROGRAM_PUBKEY_ARRAY="\$SELF_PROGRAM_PUBKEY_C_ARRAY"
+    -DSELF_PROGRAM_PUBKEY_ARRAY="\$SELF_PROGRAM_PUBKEY_C_ARRAY"                            \\
+    \$PROFILE_DEFINE
 
 \$SDK_ROOT/bpf/dependencies/bpf-tools/llvm/bin/ld.lld                                      \\
     -z notext                                                                             \\
@@ -67,10 +78,10 @@ SELF_PROGRAM_PUBKEY_C_ARRAY="$SELF_PROGRAM_PUBKEY_C_ARRAY"
     --Bdynamic                                                                            \\
     \$SOURCE_ROOT/program/fixed_bpf.ld                                                     \\
     --entry entrypoint                                                                    \\
-    -o program.so                                                                         \\
+    -o \$PROGRAM_SO                                                                        \\
     program.po
 
 rm program.po
 
-strip -s -R .comment --strip-unneeded program.so
+strip -s -R .comment --strip-unneeded \$PROGRAM_SO
 EOF
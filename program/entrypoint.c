@@ -1,5 +1,6 @@
 
 #include "solana_sdk.h"
+#include "manager_state.h"
 
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -120,15 +121,25 @@ typedef enum
     // Withdraws lamports from the vote account, but always leaves at least the rent exempt minimum in the vote
     // account.  Only the rewards authority may issue this instruction.
     //
+    // If the manager account has a revenue split (see SetRevenueSplit), then each recipient of the split is paid its
+    // share of the withdrawn lamports, rounded down, and the recipient account receives the rest.  In that case the
+    // manager account must be writable, because the lamports are withdrawn into it and paid out from it within this
+    // instruction, and every recipient of the split must follow the vote program id.
+    //
     // # Account references
-    //   0. `[]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   0. `[]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed; must
+    //      be `[WRITE]` if the manager account has a revenue split
     //   1. `[WRITE]` The Vote Account
     //   2. `[SIGNER]` The rewards authority
     //   3. `[WRITE]` The recipient account of the withdrawn lamports
     //   4. `[]` The vote program id
+    //   5+. `[WRITE]` The recipients of the revenue split, in the order that they are stored in the manager account
     //
     // # Instruction data
     //   Instance of WithdrawInstructionData
+    //
+    // # Return data
+    //   u64 number of lamports withdrawn from the vote account, including those paid to the revenue split recipients
     Instruction_Withdraw                      = 8,
 
     // Sets the commission of the vote account.  Only the rewards authority may issue this instruction.
@@ -141,7 +152,181 @@ typedef enum
     //
     // # Instruction data
     //   Instance of SetCommissionInstructionData
-    Instruction_SetCommission                 = 9
+    //
+    // # Return data
+    //   Instance of CommissionReturnData
+    Instruction_SetCommission                 = 9,
+
+    // Executes a sequence of operations on a single vote account, in order, within one instruction.  Each operation
+    // is one of SetAdministrator, SetOperationalAuthority, SetRewardsAuthority, SetVoteAuthority,
+    // SetValidatorIdentity, Withdraw, or SetCommission, and is executed exactly as if it were issued as a separate
+    // instruction, with the same authority requirements.  The manager account is verified only once for all
+    // operations.  If any operation fails, the entire instruction fails.
+    //
+    // # Account references
+    //   0. `[WRITE]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   1. `[WRITE]` The Vote Account
+    //   2+. Any additional accounts referenced by the operations, each with the permissions that the operations
+    //       require of it
+    //
+    // # Instruction data
+    //   Instance of BatchInstructionData, followed by the operations
+    //
+    // # Return data
+    //   The return data of the last operation that has any
+    Instruction_Batch                         = 10,
+
+    // Withdraws all available lamports from each of a set of vote accounts, all of which must have the same rewards
+    // authority.  Only the rewards authority may issue this instruction.  Vote accounts which have no lamports
+    // available to withdraw are skipped; but if no lamports at all are available to withdraw, the instruction fails.
+    // A vote account whose manager account has a revenue split cannot be included; Withdraw must be used for it.
+    //
+    // # Account references
+    //   0. `[]` Vote Account Manager state account of the first vote account
+    //   1. `[WRITE]` The first Vote Account
+    //   2. `[SIGNER]` The rewards authority
+    //   3. `[WRITE]` The recipient account of the withdrawn lamports
+    //   4. `[]` The vote program id
+    //   5+. Any number of additional pairs of:
+    //       `[]` Vote Account Manager state account
+    //       `[WRITE]` The Vote Account
+    //
+    // # Instruction data
+    //   The single byte instruction index, which for FleetWithdraw is 11
+    //
+    // # Return data
+    //   u64 total number of lamports withdrawn from all of the vote accounts
+    Instruction_FleetWithdraw                 = 11,
+
+    // Sets the commission of each of a set of vote accounts, all of which must have the same rewards authority.  Only
+    // the rewards authority may issue this instruction.  The new commission must be allowed by the commission caps of
+    // every vote account, otherwise the instruction fails.
+    //
+    // # Account references
+    //   0. `[WRITE]` Vote Account Manager state account of the first vote account
+    //   1. `[WRITE]` The first Vote Account
+    //   2. `[SIGNER]` The rewards authority
+    //   3. `[]` The vote program id
+    //   4+. Any number of additional pairs of:
+    //       `[WRITE]` Vote Account Manager state account
+    //       `[WRITE]` The Vote Account
+    //
+    // # Instruction data
+    //   Instance of SetCommissionInstructionData, with an instruction index of 12
+    //
+    // # Return data
+    //   Instance of CommissionReturnData, for the last vote account
+    Instruction_FleetSetCommission            = 12,
+
+    // Sets the revenue split of the vote account: a list of recipients, each of which is paid a share, given in basis
+    // points, of the lamports withdrawn by every subsequent Withdraw.  The shares may total at most 10000 basis
+    // points; whatever is not shared is paid to the recipient account of the Withdraw.  A split with no recipients
+    // removes the revenue split.  Only the administrator may issue this instruction.  The first time that a revenue
+    // split is set, the manager account is grown to hold it, and the funding account pays for the additional rent
+    // exempt minimum.
+    //
+    // # Account references
+    //   0. `[WRITE]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   1. `[]` The Vote Account
+    //   2. `[SIGNER]` The administrator
+    //   3. `[WRITE, SIGNER]` The account which will fund the growth of the Vote Account Manager state account
+    //   4. `[]` The system program id
+    //
+    // # Instruction data
+    //   Instance of SetRevenueSplitInstructionData, with only recipient_count entries of recipients present
+    Instruction_SetRevenueSplit               = 13,
+
+    // Sets the sweep of the vote account: a recipient account, and a minimum number of lamports.  Thereafter anyone
+    // may issue a Sweep instruction to withdraw all available lamports from the vote account to that recipient, once
+    // at least the minimum are available.  A recipient of all zeroes disables sweeping.  Only the rewards authority
+    // may issue this instruction.  The first time that a sweep is set, the manager account is grown to hold it, and
+    // the funding account pays for the additional rent exempt minimum.
+    //
+    // # Account references
+    //   0. `[WRITE]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   1. `[]` The Vote Account
+    //   2. `[SIGNER]` The rewards authority
+    //   3. `[WRITE, SIGNER]` The account which will fund the growth of the Vote Account Manager state account
+    //   4. `[]` The system program id
+    //
+    // # Instruction data
+    //   Instance of SetSweepInstructionData
+    Instruction_SetSweep                      = 14,
+
+    // Withdraws all available lamports from the vote account to the recipient set by SetSweep, exactly as a Withdraw
+    // of all available lamports to that recipient would, including paying any revenue split.  Anyone may issue this
+    // instruction, but it fails unless at least the minimum set by SetSweep are available.
+    //
+    // # Account references
+    //   0. `[]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed; must
+    //      be `[WRITE]` if the manager account has a revenue split
+    //   1. `[WRITE]` The Vote Account
+    //   2. `[WRITE]` The sweep recipient
+    //   3. `[]` The vote program id
+    //   4+. `[WRITE]` The recipients of the revenue split, in the order that they are stored in the manager account
+    //
+    // # Instruction data
+    //   u8 15
+    //
+    // # Return data
+    //   u64 number of lamports withdrawn from the vote account, including those paid to the revenue split recipients
+    Instruction_Sweep                         = 15,
+
+    // Sets the commission schedule of the vote account: a list of steps, each an epoch and the commission to be set
+    // in or after that epoch by ApplyCommissionSchedule.  The epochs must be increasing, and no earlier than the
+    // current epoch.  If commission caps are in use, then the schedule is checked against them here, as if each step
+    // were applied in its epoch: each commission must be no greater than the max commission, and no greater than the
+    // commission before it (the vote account's current commission, for the first step) plus the max commission
+    // increase per epoch.  A schedule with no steps removes the commission schedule.  Only the rewards authority may
+    // issue this instruction.  The first time that a commission schedule is set, the manager account is grown to hold
+    // it, and the funding account pays for the additional rent exempt minimum.
+    //
+    // # Account references
+    //   0. `[WRITE]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   1. `[]` The Vote Account
+    //   2. `[SIGNER]` The rewards authority
+    //   3. `[WRITE, SIGNER]` The account which will fund the growth of the Vote Account Manager state account
+    //   4. `[]` The system program id
+    //
+    // # Instruction data
+    //   Instance of SetCommissionScheduleInstructionData, with only step_count entries of steps present
+    Instruction_SetCommissionSchedule         = 16,
+
+    // Applies the next step of the commission schedule, if its epoch has been reached, setting the commission of the
+    // vote account exactly as SetCommission would, including enforcing the commission caps.  Anyone may issue this
+    // instruction.  Steps are applied in order, one per instruction, so that a step that was not applied in its epoch
+    // is applied late rather than skipped.  A step that the commission caps would reject in every later epoch too
+    // (because a leave epoch has since been set, or a SetCommission has since lowered the commission too far below
+    // it) is skipped instead, so that it does not block the steps after it.
+    //
+    // # Account references
+    //   0. `[WRITE]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   1. `[WRITE]` The Vote Account
+    //   2. `[]` The vote program id
+    //
+    // # Instruction data
+    //   u8 17
+    //
+    // # Return data
+    //   Instance of CommissionReturnData
+    Instruction_ApplyCommissionSchedule       = 17,
+
+    // Returns the state of the vote account's manager account, together with values derived from it, the vote
+    // account, and the current epoch.  This instruction changes nothing, and is intended to be simulated, so that a
+    // single simulateTransaction request can stand in for fetching and decoding several accounts.  Anyone may issue
+    // this instruction.
+    //
+    // # Account references
+    //   0. `[]` Vote Account Manager state account, computed as the PDA of the vote account pubkey + bump seed
+    //   1. `[]` The Vote Account
+    //
+    // # Instruction data
+    //   u8 18
+    //
+    // # Return data
+    //   Instance of GetStateReturnData, followed by the manager account's revenue split, sweep, and commission
+    //   schedule, in the layout of manager_state.h, for as many of them as the manager account has ever had set
+    Instruction_GetState                      = 18
 
 } Instruction;
 
@@ -225,6 +410,204 @@ typedef struct
 } SetCommissionInstructionData;
 
 
+// Data passed to a Batch instruction
+typedef struct
+{
+    // First byte is the instruction index, which for Batch is 10
+    uint8_t instruction_index;
+
+    // The number of operations that immediately follow.  Each operation is an instance of BatchOperationHeader,
+    // followed by account_count account indices, followed by data_len bytes of instruction data.
+    uint8_t operation_count;
+
+} BatchInstructionData;
+
+
+// The header of each operation within the data of a Batch instruction
+typedef struct
+{
+    // The number of accounts of the operation.  Each account is given as a u8 index into the accounts of the Batch
+    // instruction, and the accounts are in the order that the operation's instruction requires them.  The first two
+    // accounts of every operation must be index 0 (the manager account) and index 1 (the vote account).
+    uint8_t account_count;
+
+    // The number of bytes of instruction data of the operation; this is exactly the data that would be passed to the
+    // operation if it were issued as a separate instruction, beginning with its instruction index
+    uint8_t data_len;
+
+} BatchOperationHeader;
+
+
+// One recipient of a revenue split
+typedef struct __attribute__((__packed__))
+{
+    // The account to be paid the recipient's share of each Withdraw
+    SolPubkey recipient;
+
+    // The recipient's share, in basis points (1 - 10000 inclusive)
+    uint16_t share_bps;
+
+} RevenueSplitRecipient;
+
+
+// A revenue split, as given in a SetRevenueSplit instruction and as stored in the manager account at
+// MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET
+typedef struct __attribute__((__packed__))
+{
+    // The number of recipients
+    uint8_t recipient_count;
+
+    // The recipients; only the first recipient_count are in use
+    RevenueSplitRecipient recipients[MANAGER_STATE_REVENUE_SPLIT_MAX_RECIPIENTS];
+
+} RevenueSplit;
+
+
+// Data passed to a SetRevenueSplit instruction.  Only the recipients in use are present, so the instruction data is
+// shorter than this structure unless every recipient is in use.
+typedef struct __attribute__((__packed__))
+{
+    // First byte is the instruction index, which for SetRevenueSplit is 13
+    uint8_t instruction_index;
+
+    // The new revenue split
+    RevenueSplit revenue_split;
+
+} SetRevenueSplitInstructionData;
+
+
+// Data passed to a SetSweep instruction
+typedef struct
+{
+    // First byte is the instruction index, which for SetSweep is 14
+    uint8_t instruction_index;
+
+    // The account to which Sweep withdraws, or all zeroes to disable sweeping
+    SolPubkey recipient;
+
+    // The minimum number of lamports that must be available to withdraw for Sweep to succeed
+    uint64_t minimum_lamports;
+
+} SetSweepInstructionData;
+
+
+// A sweep, as stored in the manager account at MANAGER_STATE_SWEEP_RECIPIENT_OFFSET
+typedef struct __attribute__((__packed__))
+{
+    // The account to which Sweep withdraws, or all zeroes if sweeping is disabled
+    SolPubkey recipient;
+
+    // The minimum number of lamports that must be available to withdraw for Sweep to succeed
+    uint64_t minimum_lamports;
+
+} Sweep;
+
+
+// One step of a commission schedule
+typedef struct __attribute__((__packed__))
+{
+    // The epoch in or after which the step is to be applied
+    uint64_t epoch;
+
+    // The commission to set (0 - 100 inclusive)
+    uint8_t commission;
+
+} CommissionScheduleStep;
+
+
+// A commission schedule, as stored in the manager account at MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET
+typedef struct __attribute__((__packed__))
+{
+    // The number of steps
+    uint8_t step_count;
+
+    // The index of the next step to apply; step_count once every step has been applied
+    uint8_t next_step;
+
+    // The steps; only the first step_count are in use
+    CommissionScheduleStep steps[MANAGER_STATE_COMMISSION_SCHEDULE_MAX_STEPS];
+
+} CommissionSchedule;
+
+
+// Data passed to a SetCommissionSchedule instruction.  Only the steps in use are present, so the instruction data is
+// shorter than this structure unless every step is in use.
+typedef struct __attribute__((__packed__))
+{
+    // First byte is the instruction index, which for SetCommissionSchedule is 16
+    uint8_t instruction_index;
+
+    // The number of steps
+    uint8_t step_count;
+
+    // The steps
+    CommissionScheduleStep steps[MANAGER_STATE_COMMISSION_SCHEDULE_MAX_STEPS];
+
+} SetCommissionScheduleInstructionData;
+
+
+// Returned by SetCommission, FleetSetCommission, and ApplyCommissionSchedule
+typedef struct __attribute__((__packed__))
+{
+    // The commission that the vote account now has
+    uint8_t commission;
+
+    // The largest commission that SetCommission would allow to be set for the remainder of the current epoch; this is
+    // the commission itself if the leave epoch has been set, and 100 if commission caps are not in use
+    uint8_t max_allowed_commission;
+
+} CommissionReturnData;
+
+
+// Every instruction that changes a vote account or its manager account logs an event describing the change via
+// sol_log_data, so that indexers can follow the program's log messages rather than polling accounts.  An event appears
+// in the log messages as "Program data: " followed by the base64 encoding of each of three fields, space separated:
+//   0. An EventHeader
+//   1. The old value, which is empty if there is none
+//   2. The new value
+//
+// The old and new values logged by each instruction are:
+//   Enter:                   The vote account's withdraw authority / the new manager account contents, as a
+//                            VoteAccountManagerState; lamports is the number of lamports paid into the manager account
+//   SetLeaveEpoch:           u64 leave epoch / u64 leave epoch
+//   Leave:                   The manager account contents, as a VoteAccountManagerState / the vote account's restored
+//                            withdraw authority; lamports is the number of lamports returned from the manager account
+//   SetAdministrator,
+//   SetOperationalAuthority,
+//   SetRewardsAuthority:     The authority pubkey / the authority pubkey
+//   SetVoteAuthority:        Empty / the vote authority pubkey
+//   SetValidatorIdentity:    The validator identity pubkey / the validator identity pubkey
+//   Withdraw, Sweep:         Empty / the recipient account pubkey; lamports is the number of lamports withdrawn from
+//                            the vote account, including those paid to the recipients of the revenue split
+//   SetCommission,
+//   ApplyCommissionSchedule: u8 commission / u8 commission; or, for a step that ApplyCommissionSchedule skipped, the
+//                            CommissionScheduleStep / empty
+//   SetRevenueSplit:         The in-use prefix of the RevenueSplit, as in the SetRevenueSplit instruction data, or
+//                            empty if none was set / the same for the new revenue split
+//   SetSweep:                The Sweep, or empty if none was set / the new Sweep
+//   SetCommissionSchedule:   The in-use prefix of the CommissionSchedule, or empty if none was set / the same for the
+//                            new commission schedule
+//
+// Batch and the Fleet instructions log one event per operation, each identified by the instruction code of the
+// operation rather than that of the Batch or Fleet instruction.  An instruction that changes nothing, such as removing
+// a revenue split that was never set, or a FleetWithdraw operation that is skipped, logs no event.
+typedef struct __attribute__((__packed__))
+{
+    // The instruction code of the instruction that made the change
+    uint8_t instruction_code;
+
+    // The epoch in which the change was made
+    uint64_t epoch;
+
+    // The vote account that was changed, or whose manager account was changed
+    SolPubkey vote_account;
+
+    // The number of lamports moved by the change, or 0 if none were
+    uint64_t lamports;
+
+} EventHeader;
+
+
 // These are all custom errors that this program can return
 typedef enum
 {
@@ -271,6 +654,24 @@ typedef enum
     // Attempt to set commission to a value that would exceed the allowed commission increase rate
     Error_CommissionChangeTooLarge            = 1013,
 
+    // A Batch instruction included an operation that cannot be executed within a Batch
+    Error_InstructionNotAllowedInBatch        = 1014,
+
+    // Attempt to set a revenue split whose shares total more than 10000 basis points, or that has a zero share, a
+    // duplicate recipient, or the manager account or vote account as a recipient
+    Error_InvalidRevenueSplit                 = 1015,
+
+    // Attempt to Sweep a vote account for which no sweep recipient has been set
+    Error_SweepNotSet                         = 1016,
+
+    // Attempt to set a commission schedule whose epochs are not increasing, or begin before the current epoch, or
+    // that has a commission greater than 100
+    Error_InvalidCommissionSchedule           = 1017,
+
+    // Attempt to apply a commission schedule when there is no step left to apply, or the next step's epoch has not
+    // been reached
+    Error_CommissionScheduleStepNotDue        = 1018,
+
     // Errors Error_InvalidAccount_First through Error_InvalidAccount_Last are used to indicate an error in input
     // account, where the specific account that was faulty is the offset from Error_InvalidAccount_First
     Error_InvalidAccount_First                = 1100,
@@ -291,9 +692,18 @@ typedef enum
 } Error;
 
 
-// This is the state stored in a vote account manager account
-typedef struct
+// This is the state stored in a vote account manager account.  The structure is packed so that its layout is exactly
+// that given by the offsets in manager_state.h, which clients use to decode manager accounts.
+typedef struct __attribute__((__packed__))
 {
+    // Version of the layout of this structure; always MANAGER_STATE_VERSION
+    uint8_t version;
+
+    // The bump seed of the manager account's program derived address.  Stored here so that instructions other than
+    // Enter can verify the manager account address with a single sol_create_program_address call instead of a bump
+    // seed search.  Manager accounts created before this field existed have 0 here.
+    uint8_t bump_seed;
+
     // The withdraw authority at the time that the program was entered; this withdraw authority retains the ability to
     // set the administrator and to leave the program but possesses no other authority over the vote account while the
     // account is in the program
@@ -322,121 +732,347 @@ typedef struct
     // epoch for this vote account, otherwise the meaning of this this value is undefined.
     uint8_t max_commission_increase_per_epoch;
 
-    // If use_commission_caps is true, then this is epoch of the most recent commission change, otherwise the meaning
-    // of this value is undefined.
-    uint64_t commission_change_epoch;
-
     // If use_commission_caps is true, then this is the commission that was in effect in the epoch in which commission
     // was most recently changed, *before* any changes were made.  This allows commission to be changed multiple times
     // in an epoch without violating commission increase limits.  If use_commission_caps is false, then the meaning of
     // this value is undefined.
     uint8_t commission_change_epoch_original_commission;
 
+    // Current commission of the vote account.  Stored here to reduce dependencies on the data stored within vote
+    // accounts.
+    uint8_t current_commission;
+
+    // If use_commission_caps is true, then this is epoch of the most recent commission change, otherwise the meaning
+    // of this value is undefined.
+    uint64_t commission_change_epoch;
+
     // If use_commission_caps is true, then the vote account cannot Leave this program until the leave epoch, which is
     // set by the leave epoch instruction.  This is 0 before being set to a valid leave epoch.  If use_commission_caps
     // is false, then the meaning of this value is undefined.
     uint64_t leave_epoch;
 
-    // Current commission of the vote account.  Stored here to reduce dependencies on the data stored within vote
-    // accounts.
-    uint8_t current_commission;
-
 } VoteAccountManagerState;
 
 
-// --------------------------------------------------------------------------------------------------------------------
-// Internal structures, functions, and macros used by public entrypoints
-// --------------------------------------------------------------------------------------------------------------------
+// The layout of VoteAccountManagerState must be exactly that given by manager_state.h
+#define CHECK_MANAGER_STATE_OFFSET(field, offset)                                                                     \
+    _Static_assert(__builtin_offsetof(VoteAccountManagerState, field) == offset, "Bad offset of " #field)
+
+CHECK_MANAGER_STATE_OFFSET(version, MANAGER_STATE_VERSION_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(bump_seed, MANAGER_STATE_BUMP_SEED_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(withdraw_authority, MANAGER_STATE_WITHDRAW_AUTHORITY_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(administrator, MANAGER_STATE_ADMINISTRATOR_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(operational_authority, MANAGER_STATE_OPERATIONAL_AUTHORITY_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(rewards_authority, MANAGER_STATE_REWARDS_AUTHORITY_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(use_commission_caps, MANAGER_STATE_USE_COMMISSION_CAPS_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(max_commission, MANAGER_STATE_MAX_COMMISSION_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(max_commission_increase_per_epoch, MANAGER_STATE_MAX_COMMISSION_INCREASE_PER_EPOCH_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(commission_change_epoch_original_commission,
+                           MANAGER_STATE_COMMISSION_CHANGE_EPOCH_ORIGINAL_COMMISSION_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(current_commission, MANAGER_STATE_CURRENT_COMMISSION_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(commission_change_epoch, MANAGER_STATE_COMMISSION_CHANGE_EPOCH_OFFSET);
+CHECK_MANAGER_STATE_OFFSET(leave_epoch, MANAGER_STATE_LEAVE_EPOCH_OFFSET);
+_Static_assert(sizeof(VoteAccountManagerState) == MANAGER_STATE_SIZE, "Bad size of VoteAccountManagerState");
+
+// The layout of the optional revenue split must be exactly that given by manager_state.h
+_Static_assert((MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET + __builtin_offsetof(RevenueSplit, recipients)) ==
+               MANAGER_STATE_REVENUE_SPLIT_RECIPIENTS_OFFSET, "Bad offset of revenue split recipients");
+_Static_assert(sizeof(RevenueSplitRecipient) == MANAGER_STATE_REVENUE_SPLIT_RECIPIENT_SIZE,
+               "Bad size of RevenueSplitRecipient");
+_Static_assert((MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET + sizeof(RevenueSplit)) == MANAGER_STATE_REVENUE_SPLIT_END,
+               "Bad size of RevenueSplit");
+_Static_assert(MANAGER_STATE_REVENUE_SPLIT_END > MANAGER_STATE_V0_SIZE, "Legacy accounts appear to have a split");
+
+// The layout of the optional sweep must be exactly that given by manager_state.h
+_Static_assert(MANAGER_STATE_SWEEP_RECIPIENT_OFFSET == MANAGER_STATE_REVENUE_SPLIT_END, "Bad offset of sweep");
+_Static_assert((MANAGER_STATE_SWEEP_RECIPIENT_OFFSET + __builtin_offsetof(Sweep, minimum_lamports)) ==
+               MANAGER_STATE_SWEEP_MINIMUM_LAMPORTS_OFFSET, "Bad offset of sweep minimum lamports");
+_Static_assert((MANAGER_STATE_SWEEP_RECIPIENT_OFFSET + sizeof(Sweep)) == MANAGER_STATE_SWEEP_END, "Bad size of Sweep");
+
+// The layout of the optional commission schedule must be exactly that given by manager_state.h
+_Static_assert(MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET == MANAGER_STATE_SWEEP_END,
+               "Bad offset of commission schedule");
+_Static_assert((MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET + __builtin_offsetof(CommissionSchedule, next_step)) ==
+               MANAGER_STATE_COMMISSION_SCHEDULE_NEXT_STEP_OFFSET, "Bad offset of commission schedule next step");
+_Static_assert((MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET + __builtin_offsetof(CommissionSchedule, steps)) ==
+               MANAGER_STATE_COMMISSION_SCHEDULE_STEPS_OFFSET, "Bad offset of commission schedule steps");
+_Static_assert(sizeof(CommissionScheduleStep) == MANAGER_STATE_COMMISSION_SCHEDULE_STEP_SIZE,
+               "Bad size of CommissionScheduleStep");
+_Static_assert((MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET + sizeof(CommissionSchedule)) ==
+               MANAGER_STATE_COMMISSION_SCHEDULE_END, "Bad size of CommissionSchedule");
+
+
+// Returned by GetState, followed by the manager account's optional revenue split, sweep, and commission schedule
+typedef struct __attribute__((__packed__))
+{
+    // The state of the manager account.  A manager account that still has the legacy layout is returned converted to
+    // this layout.
+    VoteAccountManagerState state;
 
-static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_leave_epoch(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_administrator(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_operational_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_rewards_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_vote_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_validator_identity(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_withdraw(const SolParameters *params, const SolSignerSeeds *signer_seeds);
-static uint64_t process_set_commission(const SolParameters *params, const SolSignerSeeds *signer_seeds);
+    // The current epoch
+    uint64_t epoch;
 
+    // The lamports held by the vote account
+    uint64_t vote_account_lamports;
 
-// Macro that computes the number of elements in a static array
-#define ARRAY_LEN(a) (sizeof(a) / sizeof(*a))
+    // The number of lamports that a Withdraw of all available lamports would withdraw now
+    uint64_t withdrawable_lamports;
 
+    // The commission of the vote account
+    uint8_t commission;
 
-// These are constant values that the program can use.
-typedef struct
+    // The largest commission that SetCommission would allow to be set for the remainder of the current epoch, as in
+    // CommissionReturnData
+    uint8_t max_allowed_commission;
+
+} GetStateReturnData;
+
+// The return data of GetState must fit within the return data limit of 1024 bytes
+_Static_assert((sizeof(GetStateReturnData) + (MANAGER_STATE_COMMISSION_SCHEDULE_END - MANAGER_STATE_SIZE)) <= 1024,
+               "GetState return data is too large");
+
+
+// --------------------------------------------------------------------------------------------------------------------
+// Internal structures, functions, and macros used by public entrypoints
+// --------------------------------------------------------------------------------------------------------------------
+
+// Data structure stored in the Clock sysvar
+typedef struct __attribute__((__packed__))
 {
-    // This constant ensures that data conforming to the "Solana Security.txt" format is present in the binary.
-    // See: https://github.com/neodyme-labs/solana-security-txt
-    const char security_txt[341];
+    uint64_t slot;
 
-    // This is the Vote Account Manager program pubkey.  It is the account address that actually stores this program.
-    SolPubkey self_program_pubkey;
+    int64_t epoch_start_timestamp;
 
-    // This is the system program pubkey
-    SolPubkey system_program_pubkey;
+    uint64_t epoch;
 
-    // This is the vote program pubkey
-    SolPubkey vote_program_pubkey;
+    uint64_t leader_schedule_epoch;
 
-    // This is the clock sysvar pubkey
-    SolPubkey clock_sysvar_pubkey;
+    int64_t unix_timestamp;
 
-} _Constants;
+} Clock;
 
 
-// The _ARRAY values are provided at compile time on the command line
-static const _Constants Constants =
+// Data structure stored in the Rent sysvar.  This is not packed, because sol_get_rent_sysvar writes the runtime's
+// structure including its trailing padding, 24 bytes in total.
+typedef struct
 {
-    // security_txt
-    "=======BEGIN SECURITY.TXT V1=======\0"
-    "name\0Vote Account Manager\0"
-    "project_url\0https://github.com/bji/vote-account-manager\0"
-    "contacts\0email:shinobisystems@yahoo.com\0"
-    "policy\0https://raw.githubusercontent.com/bji/vote-account-manager/master/security_policy.txt\0"
-    "source_code\0https://github.com/bji/vote-account-manager\0"
-    "=======END SECURITY.TXT V1=======\0",
+    uint64_t lamports_per_byte_year;
 
-    // Vote Account Manager program_pubkey
-    SELF_PROGRAM_PUBKEY_ARRAY,
+    // This is an f64 value, but BPF has no floating point instructions, so it is only ever handled as its bits
+    uint64_t exemption_threshold;
 
-    // system_program_pubkey
-    SYSTEM_PROGRAM_PUBKEY_ARRAY,
+    uint8_t burn_percent;
 
-    // vote_program_pubkey
-    VOTE_PROGRAM_PUBKEY_ARRAY,
+} Rent;
 
-    // clock_sysvar_pubkey
-    CLOCK_SYSVAR_PUBKEY_ARRAY
-};
 
+// Bits of SysvarCache.present
+#define SYSVAR_CACHE_CLOCK                            (1 << 0)
+#define SYSVAR_CACHE_RENT                             (1 << 1)
+#define SYSVAR_CACHE_MANAGER_ACCOUNT_RENT_EXEMPT      (1 << 2)
+#define SYSVAR_CACHE_VOTE_ACCOUNT_RENT_EXEMPT         (1 << 3)
 
-// solana_sdk misses "const" in many places, so de-const to avoid compiler warnings.  The Constants instance is in a
-// read-only data section and instructions which modify it actually have no effect.
-#define Constants (* ((_Constants *) &Constants))
 
+// The bits of the f64 value 2.0, which is the rent exemption threshold that has been in use since genesis
+#define F64_TWO 0x4000000000000000ul
 
-// --------------------------------------------------------------------------------------------------------------------
-// Public entrypoints (visible to the BPF runtime)
-// --------------------------------------------------------------------------------------------------------------------
 
-// Program entrypoint
-uint64_t entrypoint(const uint8_t *input)
+// Sysvar values and values derived from them.  entrypoint creates one of these, empty, for each invocation of the
+// program and passes it to the instruction handlers, which fill it in lazily via get_clock(), get_rent(), and
+// the get_*_rent_exempt_minimum() functions.  This way each sysvar is fetched at most once, and only if it is
+// needed, even when a single instruction (such as Batch or a Fleet instruction) executes several operations.
+typedef struct
 {
-    SolParameters params;
+    // Bitmask of SYSVAR_CACHE_ values indicating which of the following fields have been filled in
+    uint8_t present;
 
-    // At most 7 accounts are supported for any command.  This is enough for the Enter instruction, which has the
-    // most accounts.
-    SolAccountInfo account_info[7];
-    params.ka = account_info;
+    // A legacy (version 0) manager account that is passed as read-only cannot be converted to the current layout in
+    // place, so verify_manager_account converts it into here instead, and get_manager_state() returns this
+    VoteAccountManagerState legacy_manager_state;
 
-    // Deserialize instruction parameters.
-    if (!sol_deserialize(input, &params, ARRAY_LEN(account_info))) {
-        return Error_InvalidData;
-    }
+    uint64_t manager_account_rent_exempt_minimum;
 
-    // If there isn't even an instruction code, the instruction is invalid.
+    uint64_t vote_account_rent_exempt_minimum;
+
+    // The vote account size that vote_account_rent_exempt_minimum was computed for
+    uint64_t vote_account_size;
+
+    Clock clock;
+
+    Rent rent;
+
+} SysvarCache;
+
+
+static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars);
+static uint64_t process_set_leave_epoch(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                        SysvarCache *sysvars);
+static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars);
+static uint64_t process_set_administrator(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                          SysvarCache *sysvars);
+static uint64_t process_set_operational_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                                  SysvarCache *sysvars);
+static uint64_t process_set_rewards_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                              SysvarCache *sysvars);
+static uint64_t process_set_vote_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                           SysvarCache *sysvars);
+static uint64_t process_set_validator_identity(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                               SysvarCache *sysvars);
+static uint64_t process_withdraw(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars);
+static uint64_t process_set_commission(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                       SysvarCache *sysvars);
+static uint64_t process_batch(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars);
+static uint64_t process_fleet(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars);
+static uint64_t process_set_revenue_split(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                          SysvarCache *sysvars);
+static uint64_t process_set_sweep(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                  SysvarCache *sysvars);
+static uint64_t process_sweep(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars);
+static uint64_t process_set_commission_schedule(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                                SysvarCache *sysvars);
+static uint64_t process_apply_commission_schedule(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                                  SysvarCache *sysvars);
+static uint64_t process_get_state(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                  SysvarCache *sysvars);
+static uint64_t verify_manager_account(SolAccountInfo *manager_account, const SolAccountInfo *vote_account,
+                                       uint64_t manager_account_index, SysvarCache *sysvars, uint8_t *bump_seed);
+static uint64_t check_accounts(const SolParameters *params, uint8_t instruction_code);
+static bool deserialize_input(const uint8_t *input, SolParameters *params);
+
+
+// Macro that computes the number of elements in a static array
+#define ARRAY_LEN(a) (sizeof(a) / sizeof(*a))
+
+
+// Compute unit probe marking the end of a stage of instruction processing.  When the program is built with
+// VAMP_PROFILE=1 (see build_program.sh), this logs the stage name followed by the compute units remaining, from which
+// scripts/vamp-profile computes the compute units consumed by each stage.  Otherwise it compiles to nothing.
+#ifdef VAMP_PROFILE
+#define PROFILE(stage)                                                                                                \
+    do {                                                                                                              \
+        sol_log("profile: " stage);                                                                                   \
+        sol_log_compute_units();                                                                                      \
+    } while (0)
+#else
+#define PROFILE(stage)
+#endif
+
+
+// The maximum number of accounts that an instruction may reference.  This is far more than a stack frame could hold
+// SolAccountInfo structures for, which is why deserialize_input places them in the program heap instead.  It is
+// limited to 100 so that any account can be identified by an Error_InvalidAccount or
+// Error_InvalidAccountPermissions value.
+#define MAX_ACCOUNTS 100
+
+_Static_assert((MAX_ACCOUNTS * sizeof(SolAccountInfo)) <= HEAP_LENGTH, "MAX_ACCOUNTS do not fit in the heap");
+
+
+// Pubkeys are compared and copied as four 64 bit words, inline.  This is much cheaper than comparing byte by byte, or
+// than the sol_memcpy syscall that a structure assignment of a SolPubkey compiles to.  The BPF VM permits unaligned
+// loads and stores, so these may be used on pubkeys at any address.
+typedef uint64_t __attribute__((__may_alias__)) PubkeyWord;
+
+static inline bool pubkey_equal(const SolPubkey *a, const SolPubkey *b)
+{
+    const PubkeyWord *x = (const PubkeyWord *) a;
+    const PubkeyWord *y = (const PubkeyWord *) b;
+
+    return !((x[0] ^ y[0]) | (x[1] ^ y[1]) | (x[2] ^ y[2]) | (x[3] ^ y[3]));
+}
+
+
+static inline void pubkey_copy(SolPubkey *dst, const SolPubkey *src)
+{
+    PubkeyWord *x = (PubkeyWord *) dst;
+    const PubkeyWord *y = (const PubkeyWord *) src;
+
+    x[0] = y[0];
+    x[1] = y[1];
+    x[2] = y[2];
+    x[3] = y[3];
+}
+
+
+static inline bool pubkey_is_zero(const SolPubkey *a)
+{
+    const PubkeyWord *x = (const PubkeyWord *) a;
+
+    return !(x[0] | x[1] | x[2] | x[3]);
+}
+
+
+// These are constant values that the program can use.
+typedef struct
+{
+    // This constant ensures that data conforming to the "Solana Security.txt" format is present in the binary.
+    // See: https://github.com/neodyme-labs/solana-security-txt
+    const char security_txt[341];
+
+    // This is the Vote Account Manager program pubkey.  It is the account address that actually stores this program.
+    SolPubkey self_program_pubkey;
+
+    // This is the system program pubkey
+    SolPubkey system_program_pubkey;
+
+    // This is the vote program pubkey
+    SolPubkey vote_program_pubkey;
+
+    // This is the clock sysvar pubkey
+    SolPubkey clock_sysvar_pubkey;
+
+} _Constants;
+
+
+// The _ARRAY values are provided at compile time on the command line
+static const _Constants Constants =
+{
+    // security_txt
+    "=======BEGIN SECURITY.TXT V1=======\0"
+    "name\0Vote Account Manager\0"
+    "project_url\0https://github.com/bji/vote-account-manager\0"
+    "contacts\0email:shinobisystems@yahoo.com\0"
+    "policy\0https://raw.githubusercontent.com/bji/vote-account-manager/master/security_policy.txt\0"
+    "source_code\0https://github.com/bji/vote-account-manager\0"
+    "=======END SECURITY.TXT V1=======\0",
+
+    // Vote Account Manager program_pubkey
+    SELF_PROGRAM_PUBKEY_ARRAY,
+
+    // system_program_pubkey
+    SYSTEM_PROGRAM_PUBKEY_ARRAY,
+
+    // vote_program_pubkey
+    VOTE_PROGRAM_PUBKEY_ARRAY,
+
+    // clock_sysvar_pubkey
+    CLOCK_SYSVAR_PUBKEY_ARRAY
+};
+
+
+// solana_sdk misses "const" in many places, so de-const to avoid compiler warnings.  The Constants instance is in a
+// read-only data section and instructions which modify it actually have no effect.
+#define Constants (* ((_Constants *) &Constants))
+
+
+// --------------------------------------------------------------------------------------------------------------------
+// Public entrypoints (visible to the BPF runtime)
+// --------------------------------------------------------------------------------------------------------------------
+
+// Program entrypoint
+uint64_t entrypoint(const uint8_t *input)
+{
+    SolParameters params;
+
+    // Deserialize instruction parameters.  Up to MAX_ACCOUNTS accounts are supported, which allows a Batch instruction
+    // to reference the accounts of several operations, and the Fleet instructions to reference as many vote accounts
+    // as will fit in a transaction.
+    if (!deserialize_input(input, &params)) {
+        return Error_IncorrectNumberOfAccounts;
+    }
+
+    PROFILE("deserialize");
+
+    // If there isn't even an instruction code, the instruction is invalid.
     if (params.data_len < 1) {
         return Error_InvalidDataSize;
     }
@@ -444,18 +1080,22 @@ uint64_t entrypoint(const uint8_t *input)
     // The instruction code is the first byte in the instruction data
     uint8_t instruction_code = params.data[0];
 
+    // Reject unknown instructions before doing any program derived address computation
+    if (instruction_code > Instruction_GetState) {
+        return Error_UnknownInstruction;
+    }
+
     // All instructions include a manager_account as the first account, and a vote_account as the second account.
     if (params.ka_num < 2) {
         return Error_IncorrectNumberOfAccounts;
     }
 
-    const SolAccountInfo *manager_account = &(params.ka[0]);
+    SolAccountInfo *manager_account = &(params.ka[0]);
     const SolAccountInfo *vote_account = &(params.ka[1]);
 
-    // The vote account must be a valid, existing vote account
-    if ((vote_account->data_len == 0) || !SolPubkey_same(vote_account->owner, &(Constants.vote_program_pubkey))) {
-        return Error_InvalidAccount_First + 1;
-    }
+    // Sysvars are fetched only if and when an instruction needs them
+    SysvarCache sysvars;
+    sysvars.present = 0;
 
     // All instructions require that the manager_account be the correct account for the given vote_account, and must
     // use signing seeds to sign transactions on behalf of this program.  Verify the accounts and compute the signing
@@ -465,72 +1105,114 @@ uint64_t entrypoint(const uint8_t *input)
     SolPubkey pubkey;
     uint8_t bump_seed;
 
-    // The program derived address seeds; the bump_seed will be derived
+    // The program derived address seeds; the bump_seed is either derived or loaded from the manager account state
     SolSignerSeed seeds[] = { { (const uint8_t *) vote_account->key, sizeof(SolPubkey) },
                               { (const uint8_t *) &bump_seed, sizeof(bump_seed) } };
 
-    // Only the first seed (vote account pubkey) is used when trying to find the address.  The second seed is the
-    // bump_seed, which is filled in by this function call.
-    uint64_t ret = sol_try_find_program_address(seeds, 1, &(Constants.self_program_pubkey), &pubkey, &bump_seed);
-    if (ret) {
-        return ret;
-    }
+    // If the instruction was Enter, then the bump seed must be found, and the manager account must either not exist,
+    // or must exist as owned by the system program
+    if (instruction_code == Instruction_Enter) {
+        // The vote account must be a valid, existing vote account
+        if ((vote_account->data_len == 0) ||
+            !pubkey_equal(vote_account->owner, &(Constants.vote_program_pubkey))) {
+            return Error_InvalidAccount_First + 1;
+        }
 
-    // Ensure that the program derived address that was computed is the same address that was passed in as the manager
-    // account address
-    if (!SolPubkey_same(&pubkey, /* manager account */ manager_account->key)) {
-        return Error_InvalidAccount_First;
-    }
+        // Only the first seed (vote account pubkey) is used when trying to find the address.  The second seed is the
+        // bump_seed, which is filled in by this function call.
+        uint64_t ret = sol_try_find_program_address(seeds, 1, &(Constants.self_program_pubkey), &pubkey, &bump_seed);
+        if (ret) {
+            return ret;
+        }
+
+        // Ensure that the program derived address that was computed is the same address that was passed in as the
+        // manager account address
+        if (!pubkey_equal(&pubkey, /* manager account */ manager_account->key)) {
+            return Error_InvalidAccount_First;
+        }
 
-    // If the instruction was Enter, then the manager account must either not exist, or must exist as owned by the
-    // system program
-    if (instruction_code == Instruction_Enter) {
         if ((manager_account->data_len > 0) &&
-            !SolPubkey_same(manager_account->owner, &(Constants.system_program_pubkey))) {
+            !pubkey_equal(manager_account->owner, &(Constants.system_program_pubkey))) {
             return Error_ManagerAccountAlreadyExists;
         }
     }
-    // Else the manager account must be owned by this program, and exist with enough data to be big enough to hold an
-    // instance of VoteAccountManagerState
-    else if ((manager_account->data_len < sizeof(VoteAccountManagerState)) ||
-             !SolPubkey_same(manager_account->owner, &(Constants.self_program_pubkey))) {
-        return Error_InvalidAccount_First;
+    // Else the manager account must already exist as the manager account of the vote account
+    else {
+        uint64_t ret = verify_manager_account(manager_account, vote_account, 0, &sysvars, &bump_seed);
+        if (ret) {
+            return ret;
+        }
     }
 
+    PROFILE("pda");
+
     // Seeds to use when doing invoke_signed
     SolSignerSeeds signer_seeds = { seeds, ARRAY_LEN(seeds) };
 
+    // Check the accounts of instructions that take a fixed list of accounts
+    uint64_t ret = check_accounts(&params, instruction_code);
+    if (ret) {
+        return ret;
+    }
+
+    PROFILE("accounts");
+
     // For each instruction code, call the appropriate function to handle that instruction, and return its result
     switch (instruction_code) {
     case Instruction_Enter:
-        return process_enter(&params, &signer_seeds);
+        return process_enter(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetLeaveEpoch:
-        return process_set_leave_epoch(&params, &signer_seeds);
+        return process_set_leave_epoch(&params, &signer_seeds, &sysvars);
 
     case Instruction_Leave:
-        return process_leave(&params, &signer_seeds);
+        return process_leave(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetAdministrator:
-        return process_set_administrator(&params, &signer_seeds);
+        return process_set_administrator(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetOperationalAuthority:
-        return process_set_operational_authority(&params, &signer_seeds);
+        return process_set_operational_authority(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetRewardsAuthority:
-        return process_set_rewards_authority(&params, &signer_seeds);
+        return process_set_rewards_authority(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetVoteAuthority:
-        return process_set_vote_authority(&params, &signer_seeds);
+        return process_set_vote_authority(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetValidatorIdentity:
-        return process_set_validator_identity(&params, &signer_seeds);
+        return process_set_validator_identity(&params, &signer_seeds, &sysvars);
 
     case Instruction_Withdraw:
-        return process_withdraw(&params, &signer_seeds);
+        return process_withdraw(&params, &signer_seeds, &sysvars);
 
     case Instruction_SetCommission:
-        return process_set_commission(&params, &signer_seeds);
+        return process_set_commission(&params, &signer_seeds, &sysvars);
+
+    case Instruction_Batch:
+        return process_batch(&params, &signer_seeds, &sysvars);
+
+    case Instruction_FleetWithdraw:
+    case Instruction_FleetSetCommission:
+        return process_fleet(&params, &signer_seeds, &sysvars);
+
+    case Instruction_SetRevenueSplit:
+        return process_set_revenue_split(&params, &signer_seeds, &sysvars);
+
+    case Instruction_SetSweep:
+        return process_set_sweep(&params, &signer_seeds, &sysvars);
+
+    case Instruction_Sweep:
+        return process_sweep(&params, &signer_seeds, &sysvars);
+
+    case Instruction_SetCommissionSchedule:
+        return process_set_commission_schedule(&params, &signer_seeds, &sysvars);
+
+    case Instruction_ApplyCommissionSchedule:
+        return process_apply_commission_schedule(&params, &signer_seeds, &sysvars);
+
+    case Instruction_GetState:
+        return process_get_state(&params, &signer_seeds, &sysvars);
 
     default:
         return Error_UnknownInstruction;
@@ -559,7 +1241,8 @@ extern uint64_t sol_get_rent_sysvar(void *ret);
 
 // Private structure definitions -------------------------------------------------------------------------------------
 
-// These are identifiers of all "known accounts" which are accounts at fixed account addresses
+// These are identifiers of all "known accounts" which are accounts at fixed account addresses.  The pubkeys of the
+// known accounts are stored in Constants in the same order.
 typedef enum
 {
     KnownAccount_NotKnown,               // Not a known account
@@ -571,11 +1254,12 @@ typedef enum
 } KnownAccount;
 
 
-// All indicators of account writability that may be checked against
+// All indicators of account writability that may be checked against.  These, the AccountSigner values, and the
+// KnownAccount values occupy distinct bits so that they can be combined into a single AccountSchema entry.
 typedef enum
 {
     ReadOnly = 0,
-    ReadWrite = 1
+    ReadWrite = 0x10
 
 } AccountWriteable;
 
@@ -584,54 +1268,58 @@ typedef enum
 typedef enum
 {
     NotSigner = 0,
-    Signer = 1
+    Signer = 0x20
 
 } AccountSigner;
 
 
-// Data structure stored in the Clock sysvar
-typedef struct __attribute__((__packed__))
-{
-    uint64_t slot;
-
-    int64_t epoch_start_timestamp;
-
-    uint64_t epoch;
-
-    uint64_t leader_schedule_epoch;
+// Mask of the KnownAccount value within an AccountSchema entry
+#define ACCOUNT_SCHEMA_KNOWN_ACCOUNT_MASK 0x0F
 
-    int64_t unix_timestamp;
 
-} Clock;
+// The accounts that an instruction takes.  Each entry of accounts is an AccountWriteable, an AccountSigner, and a
+// KnownAccount, or'd together.
+typedef struct
+{
+    // The number of accounts that the instruction takes, or 0 if the instruction takes a variable number of accounts
+    // and checks them itself
+    uint8_t account_count;
 
+    uint8_t accounts[7];
 
-// Data structure stored in the Rent sysvar
-typedef struct __attribute__((__packed__))
-{
-    uint64_t lamports_per_byte_year;
+    // If true, the instruction may take additional accounts following these, which it checks itself
+    bool additional_accounts;
 
-    uint8_t exemption_threshold[8];
+} AccountSchema;
 
-    uint8_t burn_percent;
 
-} Rent;
+// Offsets of the fields of the VoteState stored in vote accounts that this program reads.  Every version of VoteState
+// begins with a u32 version number followed by the node pubkey.  Version 0 (0.23.5) then has the authorized voter,
+// its epoch, and a 32 entry circular buffer of prior voters before the authorized withdrawer and commission.  Versions
+// 1 (1.14.11) and 2 (current) have the authorized withdrawer and commission immediately after the node pubkey.
+// Version 3 (V4) follows the authorized withdrawer with two more pubkeys and then holds commission in basis points.
+#define VOTE_STATE_VERSION_OFFSET                     0
+#define VOTE_STATE_NODE_PUBKEY_OFFSET                 4
+#define VOTE_STATE_V0_AUTHORIZED_WITHDRAWER_OFFSET    1876
+#define VOTE_STATE_V0_COMMISSION_OFFSET               1908
+#define VOTE_STATE_V1_AUTHORIZED_WITHDRAWER_OFFSET    36
+#define VOTE_STATE_V1_COMMISSION_OFFSET               68
+#define VOTE_STATE_V4_AUTHORIZED_WITHDRAWER_OFFSET    36
+#define VOTE_STATE_V4_COMMISSION_BPS_OFFSET           132
 
 
-// Data structure stored in a vote account.  This is only the needed fields.  Note that this may incorrectly
-// reflect the Vote Account state on chain if the Vote Account state version has changed beyond 2.  See the
-// comments for the get_vote_account_commission function for more details.
-typedef struct __attribute__((__packed__))
+// The fields of a vote account's VoteState that this program uses, as parsed by parse_vote_state.  The pubkeys point
+// directly into the vote account data.
+typedef struct
 {
-    uint32_t version;
-
-    SolPubkey node_pubkey;
+    const SolPubkey *node_pubkey;
 
-    SolPubkey authorized_withdrawer;
+    const SolPubkey *authorized_withdrawer;
 
+    // Commission as a percentage
     uint8_t commission;
 
-    // The remaining fields are not presented here as they will never be referenced
-} VoteStatePrefix;
+} VoteStateFields;
 
 
 // Data used in a System program transfer instruction
@@ -644,6 +1332,20 @@ typedef struct __attribute__((__packed__))
 } SystemTransferData;
 
 
+// To be used as data to pass to the system program when invoking CreateAccount
+typedef struct __attribute__((__packed__))
+{
+    uint32_t instruction_code; // 0 for CreateAccount
+
+    uint64_t lamports;
+
+    uint64_t space;
+
+    SolPubkey owner;
+
+} SystemCreateAccountData;
+
+
 // To be used as data to pass to the system program when invoking Allocate
 typedef struct __attribute__((__packed__))
 {
@@ -706,219 +1408,859 @@ typedef struct __attribute__((__packed__))
 
 // Account helpers ----------------------------------------------------------------------------------------------------
 
-// These helper macros make it easier and less error-prone to enforce that specific accounts are present in the
-// instruction accounts list
+// The accounts of each instruction, indexed by instruction code.  entrypoint checks the accounts of every instruction
+// that takes a fixed list of accounts against its schema, in a single pass, before calling the instruction's process_
+// function; Batch and the Fleet instructions do the same for each operation that they execute.  Thus the process_
+// functions can use their accounts without checking them.
+static const AccountSchema account_schemas[] =
+{
+    [Instruction_Enter] = { 7, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadWrite | Signer    | KnownAccount_NotKnown,                        // 2. funding_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 3. withdraw_authority
+        ReadOnly  | NotSigner | KnownAccount_SystemProgram,                   // 4. system_program_id
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram,                     // 5. vote_program_id
+        ReadOnly  | NotSigner | KnownAccount_ClockSysvar                      // 6. clock_sysvar
+    } },
+
+    [Instruction_SetLeaveEpoch] = { 3, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown                         // 2. withdraw_authority
+    } },
+
+    [Instruction_Leave] = { 6, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. withdraw_authority
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 3. recipient_account
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram,                     // 4. vote_program_id
+        ReadOnly  | NotSigner | KnownAccount_ClockSysvar                      // 5. clock_sysvar
+    } },
+
+    [Instruction_SetAdministrator] = { 3, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown                         // 2. withdraw_authority
+    } },
+
+    [Instruction_SetOperationalAuthority] = { 3, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown                         // 2. administrator
+    } },
+
+    [Instruction_SetRewardsAuthority] = { 3, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown                         // 2. administrator
+    } },
+
+    [Instruction_SetVoteAuthority] = { 5, {
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. operational_authority
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram,                     // 3. vote_program_id
+        ReadOnly  | NotSigner | KnownAccount_ClockSysvar                      // 4. clock_sysvar
+    } },
+
+    [Instruction_SetValidatorIdentity] = { 5, {
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. operational_authority
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 3. new_validator_identity
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram                      // 4. vote_program_id
+    } },
+
+    [Instruction_Withdraw] = { 5, {
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. rewards_authority
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 3. recipient_account
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram                      // 4. vote_program_id
+    }, /* revenue split recipients */ true },
+
+    [Instruction_SetCommission] = { 4, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. rewards_authority
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram                      // 3. vote_program_id
+    } },
+
+    // These take a variable number of accounts and check them themselves
+    [Instruction_Batch] = { 0 },
+    [Instruction_FleetWithdraw] = { 0 },
+    [Instruction_FleetSetCommission] = { 0 },
+
+    [Instruction_SetRevenueSplit] = { 5, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. administrator
+        ReadWrite | Signer    | KnownAccount_NotKnown,                        // 3. funding_account
+        ReadOnly  | NotSigner | KnownAccount_SystemProgram                    // 4. system_program_id
+    } },
+
+    [Instruction_SetSweep] = { 5, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. rewards_authority
+        ReadWrite | Signer    | KnownAccount_NotKnown,                        // 3. funding_account
+        ReadOnly  | NotSigner | KnownAccount_SystemProgram                    // 4. system_program_id
+    } },
+
+    [Instruction_Sweep] = { 4, {
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 2. recipient_account
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram                      // 3. vote_program_id
+    }, /* revenue split recipients */ true },
+
+    [Instruction_SetCommissionSchedule] = { 5, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | Signer    | KnownAccount_NotKnown,                        // 2. rewards_authority
+        ReadWrite | Signer    | KnownAccount_NotKnown,                        // 3. funding_account
+        ReadOnly  | NotSigner | KnownAccount_SystemProgram                    // 4. system_program_id
+    } },
+
+    [Instruction_ApplyCommissionSchedule] = { 3, {
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadWrite | NotSigner | KnownAccount_NotKnown,                        // 1. vote_account
+        ReadOnly  | NotSigner | KnownAccount_VoteProgram                      // 2. vote_program_id
+    } },
+
+    [Instruction_GetState] = { 2, {
+        ReadOnly  | NotSigner | KnownAccount_NotKnown,                        // 0. manager_account
+        ReadOnly  | NotSigner | KnownAccount_NotKnown                         // 1. vote_account
+    } }
+};
 
-#define DECLARE_ACCOUNTS uint8_t _account_num = 0;
 
-#define DECLARE_ACCOUNT(n, name, writable, signer, known_account) }                                                    \
-    if (_account_num == params->ka_num) {                                                                              \
-        return Error_IncorrectNumberOfAccounts;                                                                        \
-    }                                                                                                                  \
-    SolAccountInfo *name = &(params->ka[_account_num++]);                                                              \
-    if (!check_known_account(name, (known_account))) {                                                                 \
-        return Error_InvalidAccount_First + (_account_num - 1);                                                        \
-    }                                                                                                                  \
-    if (((writable == ReadWrite) && !name->is_writable) ||                                                             \
-        ((signer == Signer) && !name->is_signer)) {                                                                    \
-        return Error_InvalidAccountPermissions_First + (_account_num - 1);                                             \
-    } {
+// The pubkeys of the known accounts are consecutive in Constants, in KnownAccount order
+_Static_assert((__builtin_offsetof(_Constants, clock_sysvar_pubkey) -
+                __builtin_offsetof(_Constants, self_program_pubkey)) ==
+               ((KnownAccount_ClockSysvar - KnownAccount_SelfProgram) * sizeof(SolPubkey)),
+               "Known account pubkeys are not consecutive");
+
+
+// Deserializes the program input in a single pass over it.  As with the SDK's sol_deserialize, each SolAccountInfo
+// points directly into the input rather than copying any account data.  Unlike sol_deserialize, the SolAccountInfo
+// array is placed at the start of the program heap rather than in a fixed size array on the stack, and the account
+// count is checked rather than the accounts beyond the array being silently dropped.  Returns false if there are more
+// than MAX_ACCOUNTS accounts.
+static bool deserialize_input(const uint8_t *input, SolParameters *params)
+{
+    params->ka = (SolAccountInfo *) HEAP_START_ADDRESS;
+    params->ka_num = *((const uint64_t *) input);
+    input += sizeof(uint64_t);
 
-#define DECLARE_ACCOUNTS_NUMBER(n) if (params->ka_num != (n)) { return Error_IncorrectNumberOfAccounts; }
+    if (params->ka_num > MAX_ACCOUNTS) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < params->ka_num; i++) {
+        SolAccountInfo *ka = &(params->ka[i]);
+
+        // The first byte is the index of the earlier account that this one duplicates, or UINT8_MAX if none
+        const uint8_t dup_info = input[0];
+
+        if (dup_info == UINT8_MAX) {
+            ka->is_signer = input[1];
+            ka->is_writable = input[2];
+            ka->executable = input[3];
+            // 4 bytes of padding follow the flags
+            input += 8;
+            ka->key = (SolPubkey *) input;
+            input += sizeof(SolPubkey);
+            ka->owner = (SolPubkey *) input;
+            input += sizeof(SolPubkey);
+            ka->lamports = (uint64_t *) input;
+            input += sizeof(uint64_t);
+            ka->data_len = *((const uint64_t *) input);
+            input += sizeof(uint64_t);
+            ka->data = (uint8_t *) input;
+            // The data is followed by space into which it may grow, and then padding to 8 byte alignment
+            input += ka->data_len + MAX_PERMITTED_DATA_INCREASE;
+            input = (const uint8_t *) ((((uint64_t) input) + 7) & ~7ul);
+            ka->rent_epoch = *((const uint64_t *) input);
+            input += sizeof(uint64_t);
+        }
+        else {
+            *ka = params->ka[dup_info];
+            // 7 bytes of padding follow the index
+            input += 8;
+        }
+    }
+
+    params->data_len = *((const uint64_t *) input);
+    input += sizeof(uint64_t);
+    params->data = input;
+    input += params->data_len;
+    params->program_id = (const SolPubkey *) input;
 
+    return true;
+}
 
-// This function implements checking an input account to ensure that it is the same account as the specified account,
-// unless the specified account is KnownAccount_NotKnown
-static bool check_known_account(const SolAccountInfo *account, KnownAccount known_account)
+
+// Checks the accounts of params against the schema of the instruction: that each known account is the correct
+// account, that each account has the required permissions, and that the number of accounts is correct.  The checks
+// are done account by account in order, and the first failure is returned.  Instructions that take a variable number
+// of accounts are not checked, and any additional accounts of instructions that allow them are left to the
+// instruction to check.
+static uint64_t check_accounts(const SolParameters *params, uint8_t instruction_code)
 {
-    const SolPubkey *known_pubkey;
+    const AccountSchema *schema = &(account_schemas[instruction_code]);
 
-    switch (known_account) {
-    case KnownAccount_NotKnown:
-        return true;
+    if (schema->account_count == 0) {
+        return 0;
+    }
+
+    const SolPubkey *known_pubkeys = &(Constants.self_program_pubkey);
+
+    for (uint64_t i = 0; i < schema->account_count; i++) {
+        if (i == params->ka_num) {
+            return Error_IncorrectNumberOfAccounts;
+        }
 
-    case KnownAccount_SelfProgram:
-        known_pubkey = &(Constants.self_program_pubkey);
-        break;
+        const SolAccountInfo *account = &(params->ka[i]);
+        const uint8_t requirements = schema->accounts[i];
+        const uint8_t known_account = requirements & ACCOUNT_SCHEMA_KNOWN_ACCOUNT_MASK;
 
-    case KnownAccount_SystemProgram:
-        known_pubkey = &(Constants.system_program_pubkey);
-        break;
+        if (known_account &&
+            !pubkey_equal(account->key, &(known_pubkeys[known_account - KnownAccount_SelfProgram]))) {
+            return Error_InvalidAccount_First + i;
+        }
 
-    case KnownAccount_VoteProgram:
-        known_pubkey = &(Constants.vote_program_pubkey);
-        break;
+        if (((requirements & ReadWrite) && !account->is_writable) || ((requirements & Signer) && !account->is_signer)) {
+            return Error_InvalidAccountPermissions_First + i;
+        }
+    }
 
-    case KnownAccount_ClockSysvar:
-        known_pubkey = &(Constants.clock_sysvar_pubkey);
-        break;
+    if ((params->ka_num != schema->account_count) && !schema->additional_accounts) {
+        return Error_IncorrectNumberOfAccounts;
     }
 
-    return SolPubkey_same(account->key, known_pubkey);
+    return 0;
 }
 
 
-// Ensures that the instruction's data is exactly sized for the given structure type, and if not, returns an
-// error; if the size is correct, casts the instruction data to a const variable
-#define DECLARE_DATA(type, variable)                                                                                   \
-    if ((params->data_len) != sizeof(type)) {                                                                          \
-        return Error_InvalidDataSize;                                                                                  \
-    }                                                                                                                  \
-    const type *variable = (type *) params->data
+// Converts the data of a legacy (version 0) manager account into the current layout
+static void convert_legacy_manager_state(const uint8_t *data, VoteAccountManagerState *state)
+{
+    state->version = MANAGER_STATE_VERSION;
+    state->bump_seed = data[MANAGER_STATE_V0_BUMP_SEED_OFFSET];
+    pubkey_copy(&(state->withdraw_authority), (const SolPubkey *) &(data[MANAGER_STATE_V0_WITHDRAW_AUTHORITY_OFFSET]));
+    pubkey_copy(&(state->administrator), (const SolPubkey *) &(data[MANAGER_STATE_V0_ADMINISTRATOR_OFFSET]));
+    pubkey_copy(&(state->operational_authority),
+                (const SolPubkey *) &(data[MANAGER_STATE_V0_OPERATIONAL_AUTHORITY_OFFSET]));
+    pubkey_copy(&(state->rewards_authority), (const SolPubkey *) &(data[MANAGER_STATE_V0_REWARDS_AUTHORITY_OFFSET]));
+    state->use_commission_caps = data[MANAGER_STATE_V0_USE_COMMISSION_CAPS_OFFSET];
+    state->max_commission = data[MANAGER_STATE_V0_MAX_COMMISSION_OFFSET];
+    state->max_commission_increase_per_epoch = data[MANAGER_STATE_V0_MAX_COMMISSION_INCREASE_PER_EPOCH_OFFSET];
+    state->commission_change_epoch_original_commission =
+        data[MANAGER_STATE_V0_COMMISSION_CHANGE_EPOCH_ORIGINAL_COMMISSION_OFFSET];
+    state->current_commission = data[MANAGER_STATE_V0_CURRENT_COMMISSION_OFFSET];
+    // The legacy layout was naturally aligned, and account data is always 8 byte aligned, so these loads are aligned
+    state->commission_change_epoch = *((const uint64_t *) &(data[MANAGER_STATE_V0_COMMISSION_CHANGE_EPOCH_OFFSET]));
+    state->leave_epoch = *((const uint64_t *) &(data[MANAGER_STATE_V0_LEAVE_EPOCH_OFFSET]));
+}
 
 
-// Computes rent exempt minimum lamports for a given account size.  This may overestimate slightly.
-static uint64_t get_rent_exempt_minimum(uint64_t account_size)
+// Verifies that vote_account is a valid, existing vote account, and that manager_account exists as a manager account
+// and is the correct Vote Account Manager state account for vote_account.  manager_account_index is the index of
+// manager_account within the instruction's accounts; vote_account must immediately follow it, and these indices are
+// used to form the errors returned.  On success, *bump_seed is set to the bump seed of the manager account address.
+//
+// A manager account with the legacy (version 0) layout is converted to the current layout: in place if it is
+// writable, which shrinks the account to the current size, and otherwise into sysvars->legacy_manager_state, which
+// is where get_manager_state() will then find it.
+static uint64_t verify_manager_account(SolAccountInfo *manager_account, const SolAccountInfo *vote_account,
+                                       uint64_t manager_account_index, SysvarCache *sysvars, uint8_t *bump_seed)
 {
-    // Get the rent sysvar value
-    Rent rent;
-    uint64_t result = sol_get_rent_sysvar(&rent);
-
-    // Unfortunately the exemption threshold is in f64 format.  This makes it super difficult to work with since BPF
-    // doesn't have floating point instructions.  So do manual computation using the bits of the floating point value.
-    uint64_t u = * (uint64_t *) rent.exemption_threshold;
-    uint64_t exp = ((u >> 52) & 0x7FF);
+    // The vote account must be a valid, existing vote account
+    if ((vote_account->data_len == 0) || !pubkey_equal(vote_account->owner, &(Constants.vote_program_pubkey))) {
+        return Error_InvalidAccount_First + manager_account_index + 1;
+    }
 
-    if (result || // sol_get_rent_sysvar failed, so u and exp are bogus
-        (u & 0x8000000000000000ul) || // negative exemption_threshold
-        ((exp == 0) || (exp == 0x7FF))) { // subnormal values
-        // Unsupported and basically nonsensical rent exemption threshold.  Just use some hopefully sane default based
-        // on historical values that were true for 2021/2022: lamports_per_byte_year = 3480, exemption_threshold = 2
-        // years
-        return (account_size + 128) * 3480 * 2;
+    // The manager account must be owned by this program.  Because only this program can write the data of an account
+    // that it owns, the bump seed stored there can be trusted to be the one that was found when the account was
+    // created.
+    if (!pubkey_equal(manager_account->owner, &(Constants.self_program_pubkey))) {
+        return Error_InvalidAccount_First + manager_account_index;
     }
 
-    // 128 bytes are added for account overhead
-    uint64_t min = (account_size + 128) * rent.lamports_per_byte_year;
+    VoteAccountManagerState *manager_account_state;
 
-    if (exp >= 1023) {
-        min *= (1 << (exp - 1023));
+    if (manager_account->data_len == MANAGER_STATE_V0_SIZE) {
+        convert_legacy_manager_state(manager_account->data, &(sysvars->legacy_manager_state));
+        if (manager_account->is_writable) {
+            sol_memcpy(manager_account->data, &(sysvars->legacy_manager_state), sizeof(VoteAccountManagerState));
+            ((uint64_t *) (manager_account->data))[-1] = sizeof(VoteAccountManagerState);
+            manager_account->data_len = sizeof(VoteAccountManagerState);
+            manager_account_state = (VoteAccountManagerState *) manager_account->data;
+        }
+        else {
+            manager_account_state = &(sysvars->legacy_manager_state);
+        }
     }
+    // Otherwise the manager account must be big enough to hold an instance of VoteAccountManagerState, of the
+    // current version
     else {
-        min /= (1 << (1023 - exp));
+        manager_account_state = (VoteAccountManagerState *) manager_account->data;
+        if ((manager_account->data_len < sizeof(VoteAccountManagerState)) ||
+            (manager_account_state->version != MANAGER_STATE_VERSION)) {
+            return Error_InvalidAccount_First + manager_account_index;
+        }
     }
 
-    // Reduce fraction to 10 bits, to avoid overflow.  Keep track of whether or not to round up.
-    uint64_t fraction = u & 0x000FFFFFFFFFFFFFul;
-    bool round_up = (fraction & 0x3FFFFFFFFFFul);
+    *bump_seed = manager_account_state->bump_seed;
+
+    SolPubkey pubkey;
+
+    SolSignerSeed seeds[] = { { (const uint8_t *) vote_account->key, sizeof(SolPubkey) },
+                              { (const uint8_t *) bump_seed, sizeof(*bump_seed) } };
+
+    // A bump seed of 0 means that the manager account was created before bump seeds were stored, so the bump seed
+    // must be found.  If the manager account is writable, save the bump seed so that subsequent instructions can skip
+    // the search.
+    if (*bump_seed == 0) {
+        uint64_t ret = sol_try_find_program_address(seeds, 1, &(Constants.self_program_pubkey), &pubkey, bump_seed);
+        if (ret) {
+            return ret;
+        }
 
-    fraction >>= 42;
-    if (round_up) {
-        fraction += 1;
+        if (manager_account->is_writable) {
+            manager_account_state->bump_seed = *bump_seed;
+        }
+    }
+    // Else the address is computed directly from both seeds, which is much cheaper than a search
+    else if (sol_create_program_address(seeds, ARRAY_LEN(seeds), &(Constants.self_program_pubkey), &pubkey)) {
+        return Error_InvalidAccount_First + manager_account_index;
     }
 
-    fraction *= min;
-    fraction /= 0x3FF;
+    // Ensure that the program derived address that was computed is the same address that was passed in as the
+    // manager account address
+    if (!pubkey_equal(&pubkey, manager_account->key)) {
+        return Error_InvalidAccount_First + manager_account_index;
+    }
 
-    return min + fraction;
+    return 0;
 }
 
 
-// Returns the current commission of a vote account in *commission_return; and returns true on success and false on
-// failure (due to a bogus vote account or incompatible vote account version).
-static bool get_vote_account_commission(const SolAccountInfo *vote_account, uint8_t *commission_return)
+// Returns the state of a manager account that verify_manager_account has verified
+static VoteAccountManagerState *get_manager_state(const SolAccountInfo *manager_account, SysvarCache *sysvars)
 {
-    if (vote_account->data_len < sizeof(VoteStatePrefix)) {
-        return false;
+    // A manager account that still has the legacy size was read-only, and so was converted into sysvars
+    if (manager_account->data_len == MANAGER_STATE_V0_SIZE) {
+        return &(sysvars->legacy_manager_state);
     }
 
-    const VoteStatePrefix *vote_state_prefix = (const VoteStatePrefix *) vote_account->data;
+    return (VoteAccountManagerState *) manager_account->data;
+}
 
-    // Only vote account state versions <= 2 are supported; if and when the vote state stored in vote accounts
-    // is updated to a version beyond this, the following will fail:
-    // - enter with use_commission_caps set to true
-    if (vote_state_prefix->version > 2) {
-        return false;
-    }
 
-    *commission_return = vote_state_prefix->commission;
+// Returns the revenue split of a manager account that verify_manager_account has verified, or null if the manager
+// account has never had a revenue split set.  A revenue split with no recipients may be returned.
+static RevenueSplit *get_revenue_split(const SolAccountInfo *manager_account)
+{
+    if (manager_account->data_len < MANAGER_STATE_REVENUE_SPLIT_END) {
+        return 0;
+    }
 
-    return true;
+    return (RevenueSplit *) &(manager_account->data[MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET]);
 }
 
 
-// Instruction processing ---------------------------------------------------------------------------------------------
+// Returns the sweep of a manager account that verify_manager_account has verified, or null if the manager account has
+// never had a sweep set.  A sweep with a recipient of all zeroes, which is disabled, may be returned.
+static Sweep *get_sweep(const SolAccountInfo *manager_account)
+{
+    if (manager_account->data_len < MANAGER_STATE_SWEEP_END) {
+        return 0;
+    }
 
-// Processes an Enter instruction.  Note that entrypoint already guaranteed that the manager_account doesn't exist as
-// a manager account yet, and that vote_account has data and is owned by the vote program, and that manager_account is
-// the correct Vote Account Manager state account for vote_account.
-static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+    return (Sweep *) &(manager_account->data[MANAGER_STATE_SWEEP_RECIPIENT_OFFSET]);
+}
+
+
+// Returns the commission schedule of a manager account that verify_manager_account has verified, or null if the
+// manager account has never had a commission schedule set.  A commission schedule with no steps may be returned.
+static CommissionSchedule *get_commission_schedule(const SolAccountInfo *manager_account)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   funding_account,               ReadWrite,  Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(3,   withdraw_authority,            ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(4,   system_program_id,             ReadOnly,   NotSigner,  KnownAccount_SystemProgram);
-        DECLARE_ACCOUNT(5,   vote_program_id,               ReadOnly,   NotSigner,  KnownAccount_VoteProgram);
-        DECLARE_ACCOUNT(6,   clock_sysvar,                  ReadOnly,   NotSigner,  KnownAccount_ClockSysvar);
+    if (manager_account->data_len < MANAGER_STATE_COMMISSION_SCHEDULE_END) {
+        return 0;
     }
-    DECLARE_ACCOUNTS_NUMBER(7);
 
-    // instruction_data will be set to the input data if it is of the correct size
-    DECLARE_DATA(EnterInstructionData, instruction_data);
+    return (CommissionSchedule *) &(manager_account->data[MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET]);
+}
 
-    // This is the vote account commission that will be stored in the manager account.  It defaults to 0 since its
-    // value is not needed if use_commission_caps is false.
-    uint8_t vote_account_commission = 0;
 
-    // Enforce validity of instruction data
-    if (instruction_data->use_commission_caps) {
-        // Max commission > 100 is nonsensical
-        if (instruction_data->max_commission > 100) {
-            return Error_InvalidData_First + 5;
-        }
-        // Max commission change rate > 100 is nonsensical
+// Ensures that the instruction's data is exactly sized for the given structure type, and if not, returns an
+// error; if the size is correct, casts the instruction data to a const variable
+#define DECLARE_DATA(type, variable)                                                                                   \
+    if ((params->data_len) != sizeof(type)) {                                                                          \
+        return Error_InvalidDataSize;                                                                                  \
+    }                                                                                                                  \
+    const type *variable = (type *) params->data
+
+
+// Returns the Clock sysvar, fetching it if it has not already been fetched during this invocation of the program.
+// Returns null if the Clock sysvar could not be fetched.
+static const Clock *get_clock(SysvarCache *sysvars)
+{
+    if (!(sysvars->present & SYSVAR_CACHE_CLOCK)) {
+        PROFILE("handler");
+        if (sol_get_clock_sysvar(&(sysvars->clock))) {
+            return 0;
+        }
+        sysvars->present |= SYSVAR_CACHE_CLOCK;
+        PROFILE("sysvar clock");
+    }
+
+    return &(sysvars->clock);
+}
+
+
+// Returns the Rent sysvar, fetching it if it has not already been fetched during this invocation of the program.
+// Returns null if the Rent sysvar could not be fetched.
+static const Rent *get_rent(SysvarCache *sysvars)
+{
+    if (!(sysvars->present & SYSVAR_CACHE_RENT)) {
+        PROFILE("handler");
+        if (sol_get_rent_sysvar(&(sysvars->rent))) {
+            return 0;
+        }
+        sysvars->present |= SYSVAR_CACHE_RENT;
+        PROFILE("sysvar rent");
+    }
+
+    return &(sysvars->rent);
+}
+
+
+// Returns the 128 bit product of a and b in *hi and *lo
+static void multiply_64(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+    uint64_t a_lo = a & 0xFFFFFFFFul, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xFFFFFFFFul, b_hi = b >> 32;
+
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+
+    uint64_t middle = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFul) + (lo_hi & 0xFFFFFFFFul);
+
+    *lo = (middle << 32) | (lo_lo & 0xFFFFFFFFul);
+    *hi = hi_hi + (hi_lo >> 32) + (lo_hi >> 32) + (middle >> 32);
+}
+
+
+// Returns bit n of the 128 bit value hi:lo
+#define BIT_128(hi, lo, n) (((n) < 64) ? (((lo) >> (n)) & 1) : (((hi) >> ((n) - 64)) & 1))
+
+
+// Rounds the non-zero 128 bit value hi:lo to 53 significant bits, to nearest with ties to even, exactly as f64
+// arithmetic rounds its results.  Returns the rounded significand, and adds to *exponent the power of two that the
+// significand must be multiplied by to give the rounded value.
+static uint64_t round_to_f64(uint64_t hi, uint64_t lo, int64_t *exponent)
+{
+    // Find the number of significant bits
+    uint64_t bits = 128;
+    while (!BIT_128(hi, lo, bits - 1)) {
+        bits--;
+    }
+
+    if (bits <= 53) {
+        return lo;
+    }
+
+    // Shift out the bits beyond 53, remembering whether the shifted out bits were more than, exactly, or less than
+    // half of the least significant remaining bit
+    uint64_t shift = bits - 53;
+    uint64_t significand;
+    bool sticky;
+
+    if (shift < 64) {
+        significand = (lo >> shift) | (hi << (64 - shift));
+        sticky = (shift > 1) && (lo & ((1ul << (shift - 1)) - 1));
+    }
+    else {
+        significand = hi >> (shift - 64);
+        sticky = lo || ((shift > 65) && (hi & ((1ul << (shift - 65)) - 1)));
+    }
+
+    if (BIT_128(hi, lo, shift - 1) && (sticky || (significand & 1))) {
+        significand++;
+        // Rounding up can carry into a 54th bit
+        if (significand == (1ul << 53)) {
+            significand >>= 1;
+            shift++;
+        }
+    }
+
+    *exponent += shift;
+
+    return significand;
+}
+
+
+// Computes (uint64_t) ((double) a * b), where b is given as the bits of an f64, exactly as the Rust expression
+// (a as f64 * b) as u64 would compute it: a is rounded to f64, the product is rounded to f64, and the result is
+// truncated toward zero, with negative and NaN results converting to 0 and too-large results converting to the
+// maximum u64 value.
+static uint64_t f64_multiply_to_u64(uint64_t a, uint64_t b)
+{
+    uint64_t b_exponent = (b >> 52) & 0x7FF;
+    uint64_t b_significand = b & 0x000FFFFFFFFFFFFFul;
+
+    // Negative, NaN, and zero products all convert to 0
+    if ((a == 0) || (b & 0x8000000000000000ul) || ((b_exponent == 0x7FF) && b_significand) ||
+        ((b_exponent == 0) && (b_significand == 0))) {
+        return 0;
+    }
+
+    // Infinite products convert to the maximum
+    if (b_exponent == 0x7FF) {
+        return UINT64_MAX;
+    }
+
+    int64_t exponent;
+
+    // Subnormal b has no implicit leading bit
+    if (b_exponent == 0) {
+        exponent = -1074;
+    }
+    else {
+        b_significand |= (1ul << 52);
+        exponent = ((int64_t) b_exponent) - 1075;
+    }
+
+    // Round a to f64, then multiply the significands exactly and round the product
+    uint64_t a_significand = round_to_f64(0, a, &exponent);
+
+    uint64_t hi, lo;
+    multiply_64(a_significand, b_significand, &hi, &lo);
+
+    uint64_t significand = round_to_f64(hi, lo, &exponent);
+
+    // Truncate to an integer
+    if (exponent < 0) {
+        return (exponent <= -64) ? 0 : (significand >> -exponent);
+    }
+
+    if ((exponent >= 64) || ((exponent > 0) && (significand >> (64 - exponent)))) {
+        return UINT64_MAX;
+    }
+
+    return significand << exponent;
+}
+
+
+// Computes rent exempt minimum lamports for a given account size, given the Rent sysvar, which may be null if it could
+// not be fetched.  The result is exactly what the runtime's Rent::minimum_balance() computes.
+static uint64_t compute_rent_exempt_minimum(const Rent *rent, uint64_t account_size)
+{
+    // If the Rent sysvar could not be fetched, use the runtime's default Rent values: 3480 lamports per byte year and
+    // an exemption threshold of 2 years
+    uint64_t lamports_per_byte_year = rent ? rent->lamports_per_byte_year : 3480;
+    uint64_t exemption_threshold = rent ? rent->exemption_threshold : F64_TWO;
+
+    // 128 bytes are added for account overhead
+    uint64_t lamports = (account_size + 128) * lamports_per_byte_year;
+
+    // Multiplying by 2.0 is exact, and converting lamports to f64 is exact below 2^53, so for the threshold that is
+    // always used in practice the result is simply twice the lamports
+    if ((exemption_threshold == F64_TWO) && (lamports < (1ul << 53))) {
+        return lamports * 2;
+    }
+
+    return f64_multiply_to_u64(lamports, exemption_threshold);
+}
+
+
+// Returns the rent exempt minimum lamports of a manager account, computing it if it has not already been computed
+// during this invocation of the program
+static uint64_t get_manager_account_rent_exempt_minimum(SysvarCache *sysvars)
+{
+    if (!(sysvars->present & SYSVAR_CACHE_MANAGER_ACCOUNT_RENT_EXEMPT)) {
+        sysvars->manager_account_rent_exempt_minimum =
+            compute_rent_exempt_minimum(get_rent(sysvars), sizeof(VoteAccountManagerState));
+        sysvars->present |= SYSVAR_CACHE_MANAGER_ACCOUNT_RENT_EXEMPT;
+    }
+
+    return sysvars->manager_account_rent_exempt_minimum;
+}
+
+
+// Returns the rent exempt minimum lamports of a vote account, computing it if it has not already been computed during
+// this invocation of the program for a vote account of the same size
+static uint64_t get_vote_account_rent_exempt_minimum(SysvarCache *sysvars, const SolAccountInfo *vote_account)
+{
+    if (!(sysvars->present & SYSVAR_CACHE_VOTE_ACCOUNT_RENT_EXEMPT) ||
+        (sysvars->vote_account_size != vote_account->data_len)) {
+        sysvars->vote_account_rent_exempt_minimum =
+            compute_rent_exempt_minimum(get_rent(sysvars), vote_account->data_len);
+        sysvars->vote_account_size = vote_account->data_len;
+        sysvars->present |= SYSVAR_CACHE_VOTE_ACCOUNT_RENT_EXEMPT;
+    }
+
+    return sysvars->vote_account_rent_exempt_minimum;
+}
+
+
+// Returns the lamports that may be withdrawn from a vote account: all of its lamports above its rent exempt minimum
+static uint64_t get_vote_account_withdrawable_lamports(SysvarCache *sysvars, const SolAccountInfo *vote_account)
+{
+    uint64_t rent_exempt_minimum = get_vote_account_rent_exempt_minimum(sysvars, vote_account);
+
+    if (*(vote_account->lamports) > rent_exempt_minimum) {
+        return *(vote_account->lamports) - rent_exempt_minimum;
+    }
+
+    return 0;
+}
+
+
+// Parses the VoteState stored in vote_account into *fields, reading only the bytes of the fields themselves, directly
+// from the vote account data.  Returns true on success and false on failure (due to a bogus vote account or an
+// unknown vote account version).
+static bool parse_vote_state(const SolAccountInfo *vote_account, VoteStateFields *fields)
+{
+    const uint8_t *data = vote_account->data;
+
+    if (vote_account->data_len < (VOTE_STATE_NODE_PUBKEY_OFFSET + sizeof(SolPubkey))) {
+        return false;
+    }
+
+    fields->node_pubkey = (const SolPubkey *) &(data[VOTE_STATE_NODE_PUBKEY_OFFSET]);
+
+    switch (*((const uint32_t *) &(data[VOTE_STATE_VERSION_OFFSET]))) {
+    case 0:
+        if (vote_account->data_len <= VOTE_STATE_V0_COMMISSION_OFFSET) {
+            return false;
+        }
+        fields->authorized_withdrawer = (const SolPubkey *) &(data[VOTE_STATE_V0_AUTHORIZED_WITHDRAWER_OFFSET]);
+        fields->commission = data[VOTE_STATE_V0_COMMISSION_OFFSET];
+        return true;
+
+    case 1:
+    case 2:
+        if (vote_account->data_len <= VOTE_STATE_V1_COMMISSION_OFFSET) {
+            return false;
+        }
+        fields->authorized_withdrawer = (const SolPubkey *) &(data[VOTE_STATE_V1_AUTHORIZED_WITHDRAWER_OFFSET]);
+        fields->commission = data[VOTE_STATE_V1_COMMISSION_OFFSET];
+        return true;
+
+    case 3: {
+        if (vote_account->data_len < (VOTE_STATE_V4_COMMISSION_BPS_OFFSET + sizeof(uint16_t))) {
+            return false;
+        }
+        // The vote program only sets whole percentages via UpdateCommission, but round down just in case
+        uint16_t commission_bps = *((const uint16_t *) &(data[VOTE_STATE_V4_COMMISSION_BPS_OFFSET]));
+        if (commission_bps > 10000) {
+            return false;
+        }
+        fields->authorized_withdrawer = (const SolPubkey *) &(data[VOTE_STATE_V4_AUTHORIZED_WITHDRAWER_OFFSET]);
+        fields->commission = commission_bps / 100;
+        return true;
+    }
+
+    // If and when the vote state stored in vote accounts is updated to a version beyond these, Enter with
+    // use_commission_caps set to true will fail until this function is updated
+    default:
+        return false;
+    }
+}
+
+
+// Transfers lamports from funding_account, which must be a signer of the instruction, to account, so that account
+// holds at least minimum_lamports
+static uint64_t fund_account(const SolParameters *params, const SolAccountInfo *funding_account,
+                             const SolAccountInfo *account, uint64_t minimum_lamports)
+{
+    if (*(account->lamports) >= minimum_lamports) {
+        return 0;
+    }
+
+    SolInstruction instruction;
+
+    instruction.program_id = &(Constants.system_program_pubkey);
+
+    SolAccountMeta account_metas[] =
+          ///   0. `[writable, signer]` The source account.
+        { { /* pubkey */ funding_account->key, /* is_writable */ true, /* is_signer */ true },
+          ///   1. `[writable]` The destination account.
+          { /* pubkey */ account->key, /* is_writable */ true, /* is_signer */ false } };
+
+    instruction.accounts = account_metas;
+    instruction.account_len = ARRAY_LEN(account_metas);
+
+    SystemTransferData data = { 2, minimum_lamports - *(account->lamports) };
+
+    instruction.data = (uint8_t *) &data;
+    instruction.data_len = sizeof(data);
+
+    PROFILE("handler");
+    uint64_t ret = sol_invoke(&instruction, params->ka, params->ka_num);
+    PROFILE("cpi system transfer");
+
+    return ret;
+}
+
+
+// Grows the data of a writable manager account to data_len bytes, so that it holds the optional fields that end at
+// or before data_len, first funding the additional rent exempt minimum from funding_account.  The runtime zeroes the
+// added bytes, which leaves each newly included optional field unset.  Does nothing if the manager account is already
+// at least that large.
+static uint64_t grow_manager_account(const SolParameters *params, const SolAccountInfo *funding_account,
+                                     SolAccountInfo *manager_account, SysvarCache *sysvars, uint64_t data_len)
+{
+    if (manager_account->data_len >= data_len) {
+        return 0;
+    }
+
+    uint64_t ret = fund_account(params, funding_account, manager_account,
+                                compute_rent_exempt_minimum(get_rent(sysvars), data_len));
+    if (ret) {
+        return ret;
+    }
+
+    // Setting the 64 bit value immediately preceeding the data reallocates the account
+    ((uint64_t *) (manager_account->data))[-1] = data_len;
+
+    manager_account->data_len = data_len;
+
+    return 0;
+}
+
+
+// Event helpers ------------------------------------------------------------------------------------------------------
+
+// Logs the event of the instruction in params, which has changed the vote account (params->ka[1]) or its manager
+// account, from old_value to new_value, moving lamports lamports.  The event layout is described with EventHeader.
+static uint64_t log_event(const SolParameters *params, SysvarCache *sysvars, uint64_t lamports, const void *old_value,
+                          uint64_t old_value_len, const void *new_value, uint64_t new_value_len)
+{
+    const Clock *clock = get_clock(sysvars);
+    if (!clock) {
+        return Error_FailedToGetClock;
+    }
+
+    EventHeader header;
+    header.instruction_code = params->data[0];
+    header.epoch = clock->epoch;
+    pubkey_copy(&(header.vote_account), params->ka[1].key);
+    header.lamports = lamports;
+
+    SolBytes fields[] = { { (const uint8_t *) &header, sizeof(header) },
+                          { (const uint8_t *) old_value, old_value_len },
+                          { (const uint8_t *) new_value, new_value_len } };
+
+    sol_log_data(fields, ARRAY_LEN(fields));
+
+    return 0;
+}
+
+
+// Instruction processing ---------------------------------------------------------------------------------------------
+
+// Processes an Enter instruction.  Note that entrypoint already guaranteed that the manager_account doesn't exist as
+// a manager account yet, and that vote_account has data and is owned by the vote program, and that manager_account is
+// the correct Vote Account Manager state account for vote_account.
+static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_Enter]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *funding_account = &(params->ka[2]);
+    SolAccountInfo *withdraw_authority = &(params->ka[3]);
+    SolAccountInfo *system_program_id = &(params->ka[4]);
+    SolAccountInfo *vote_program_id = &(params->ka[5]);
+    SolAccountInfo *clock_sysvar = &(params->ka[6]);
+
+    // instruction_data will be set to the input data if it is of the correct size
+    DECLARE_DATA(EnterInstructionData, instruction_data);
+
+    // This holds the vote account commission that will be stored in the manager account.  It defaults to 0 since its
+    // value is not needed if use_commission_caps is false.
+    VoteStateFields vote_state;
+    vote_state.commission = 0;
+
+    // Enforce validity of instruction data
+    if (instruction_data->use_commission_caps) {
+        // Max commission > 100 is nonsensical
+        if (instruction_data->max_commission > 100) {
+            return Error_InvalidData_First + 5;
+        }
+        // Max commission change rate > 100 is nonsensical
         if (instruction_data->max_commission_increase_per_epoch > 100) {
             return Error_InvalidData_First + 6;
         }
 
         // Check to make sure that the current commission is not already larger than the max_commission
-        if (!get_vote_account_commission(vote_account, &vote_account_commission)) {
+        if (!parse_vote_state(vote_account, &vote_state)) {
             return Error_InvalidAccount_First + 1;
         }
 
-        if (vote_account_commission > instruction_data->max_commission) {
+        if (vote_state.commission > instruction_data->max_commission) {
             return Error_CommissionTooLarge;
         }
     }
 
     // Get rent exempt minimum lamports needed for the manager account
-    uint64_t rent_exempt_minimum = get_rent_exempt_minimum(sizeof(VoteAccountManagerState));
+    uint64_t rent_exempt_minimum = get_manager_account_rent_exempt_minimum(sysvars);
 
-    // Fund the manager account
-    if (*(manager_account->lamports) < rent_exempt_minimum) {
-        uint64_t lamports = rent_exempt_minimum - *(manager_account->lamports);
+    // The lamports that the manager account held before it was funded, so that the funded lamports can be logged
+    const uint64_t original_lamports = *(manager_account->lamports);
 
+    // If the manager account does not exist yet, which is the usual case, fund, allocate, and assign it with a single
+    // CreateAccount invoke.  CreateAccount fails if the account holds any lamports, so an account that has been
+    // pre-funded falls back to the separate transfer, allocate, and assign steps below, each of which is skipped if
+    // its work has already been done.
+    uint64_t ret;
+    if ((*(manager_account->lamports) == 0) && (manager_account->data_len == 0)) {
         SolInstruction instruction;
 
         instruction.program_id = &(Constants.system_program_pubkey);
 
         SolAccountMeta account_metas[] =
-              ///   0. `[writable, signer]` The source account.
+              ///   0. `[WRITE, SIGNER]` Funding account
             { { /* pubkey */ funding_account->key, /* is_writable */ true, /* is_signer */ true },
-              ///   1. `[writable]` The destination account.
-              { /* pubkey */ manager_account->key, /* is_writable */ true, /* is_signer */ false } };
+              ///   1. `[WRITE, SIGNER]` New account
+              { /* pubkey */ manager_account->key, /* is_writable */ true, /* is_signer */ true } };
 
         instruction.accounts = account_metas;
         instruction.account_len = ARRAY_LEN(account_metas);
 
-        SystemTransferData data = { 2, lamports };
+        SystemCreateAccountData data;
+        data.instruction_code = 0;
+        data.lamports = rent_exempt_minimum;
+        data.space = sizeof(VoteAccountManagerState);
+        pubkey_copy(&(data.owner), &(Constants.self_program_pubkey));
 
         instruction.data = (uint8_t *) &data;
         instruction.data_len = sizeof(data);
 
-        uint64_t ret = sol_invoke(&instruction, params->ka, params->ka_num);
-        if (ret) {
-            return ret;
-        }
+        PROFILE("handler");
+        ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+        PROFILE("cpi system create_account");
+    }
+    // Else fund the manager account up to the rent exempt minimum
+    else {
+        ret = fund_account(params, funding_account, manager_account, rent_exempt_minimum);
+    }
+    if (ret) {
+        return ret;
     }
 
     // Allocate space for the account
     if (manager_account->data_len < sizeof(VoteAccountManagerState)) {
         // If the account is owned by the system program, then use the system Alloc instruction to allocate space
-        if (SolPubkey_same(manager_account->owner, &(Constants.system_program_pubkey))) {
+        if (pubkey_equal(manager_account->owner, &(Constants.system_program_pubkey))) {
             SolInstruction instruction;
 
             instruction.program_id = &(Constants.system_program_pubkey);
@@ -935,7 +2277,9 @@ static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds
             instruction.data = (uint8_t *) &data;
             instruction.data_len = sizeof(data);
 
+            PROFILE("handler");
             uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+            PROFILE("cpi system allocate");
             if (ret) {
                 return ret;
             }
@@ -951,7 +2295,7 @@ static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds
     }
 
     // Assign the manager account ownership
-    if (!SolPubkey_same(manager_account->owner, &(Constants.self_program_pubkey))) {
+    if (!pubkey_equal(manager_account->owner, &(Constants.self_program_pubkey))) {
         SolInstruction instruction;
 
         instruction.program_id = &(Constants.system_program_pubkey);
@@ -965,12 +2309,16 @@ static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds
         instruction.accounts = account_metas;
         instruction.account_len = ARRAY_LEN(account_metas);
 
-        SystemAssignData data = { 1, Constants.self_program_pubkey };
+        SystemAssignData data;
+        data.instruction_code = 1;
+        pubkey_copy(&(data.owner), &(Constants.self_program_pubkey));
 
         instruction.data = (uint8_t *) &data;
         instruction.data_len = sizeof(data);
 
+        PROFILE("handler");
         uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+        PROFILE("cpi system assign");
         if (ret) {
             return ret;
         }
@@ -993,12 +2341,17 @@ static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds
     instruction.accounts = account_metas;
     instruction.account_len = ARRAY_LEN(account_metas);
 
-    VoteAuthorizeData data = { 1, *(manager_account->key), 1 };
+    VoteAuthorizeData data;
+    data.enum_index = 1;
+    pubkey_copy(&(data.pubkey), manager_account->key);
+    data.authorize = 1;
 
     instruction.data = (uint8_t *) &data;
     instruction.data_len = sizeof(data);
 
-    uint64_t ret = sol_invoke(&instruction, params->ka, params->ka_num);
+    PROFILE("handler");
+    ret = sol_invoke(&instruction, params->ka, params->ka_num);
+    PROFILE("cpi vote authorize");
     if (ret) {
         return ret;
     }
@@ -1006,10 +2359,11 @@ static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds
     // Save the manager account state
     VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
 
-    manager_account_state->withdraw_authority = *(withdraw_authority->key);
-    manager_account_state->administrator = instruction_data->administrator;
-    manager_account_state->operational_authority = instruction_data->administrator;
-    manager_account_state->rewards_authority = instruction_data->administrator;
+    manager_account_state->version = MANAGER_STATE_VERSION;
+    pubkey_copy(&(manager_account_state->withdraw_authority), withdraw_authority->key);
+    pubkey_copy(&(manager_account_state->administrator), &(instruction_data->administrator));
+    pubkey_copy(&(manager_account_state->operational_authority), &(instruction_data->administrator));
+    pubkey_copy(&(manager_account_state->rewards_authority), &(instruction_data->administrator));
     manager_account_state->use_commission_caps = instruction_data->use_commission_caps;
     if (instruction_data->use_commission_caps) {
         manager_account_state->max_commission = instruction_data->max_commission;
@@ -1022,33 +2376,34 @@ static uint64_t process_enter(const SolParameters *params, const SolSignerSeeds
     manager_account_state->commission_change_epoch = 0;
     manager_account_state->commission_change_epoch_original_commission = 0;
     manager_account_state->leave_epoch = 0;
-    manager_account_state->current_commission = vote_account_commission;
+    manager_account_state->current_commission = vote_state.commission;
+    // The second signer seed is the bump seed that entrypoint found for the manager account
+    manager_account_state->bump_seed = signer_seeds->addr[1].addr[0];
 
-    return 0;
+    return log_event(params, sysvars, *(manager_account->lamports) - original_lamports, withdraw_authority->key,
+                     sizeof(SolPubkey), manager_account_state, sizeof(*manager_account_state));
 }
 
 
 // Processes a SetLeaveEpoch instruction.  Note that entrypoint already guaranteed that the manager_account exists as
 // a manager account already, and that vote_account has data and is owned by the vote program, and that
 // manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_leave_epoch(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_set_leave_epoch(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                        SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   withdraw_authority,            ReadOnly,   Signer,     KnownAccount_NotKnown);
-    }
-    DECLARE_ACCOUNTS_NUMBER(3);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetLeaveEpoch]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *withdraw_authority = &(params->ka[2]);
 
     // instruction_data will be set to the input data if it is of the correct size
     DECLARE_DATA(SetLeaveEpochInstructionData, instruction_data);
 
     // This is the vote account manager state
-    VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided withdraw authority is the withdraw authority that was saved in the manager account
-    if (!SolPubkey_same(&(manager_account_state->withdraw_authority), withdraw_authority->key)) {
+    if (!pubkey_equal(&(manager_account_state->withdraw_authority), withdraw_authority->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
@@ -1064,42 +2419,42 @@ static uint64_t process_set_leave_epoch(const SolParameters *params, const SolSi
     }
 
     // Ensure that the leave epoch is at least 1 full epoch beyond the current epoch
-    Clock clock;
-    if (sol_get_clock_sysvar(&clock)) {
+    const Clock *clock = get_clock(sysvars);
+    if (!clock) {
         return Error_FailedToGetClock;
     }
-    if (instruction_data->leave_epoch < (clock.epoch + 2)) {
+    if (instruction_data->leave_epoch < (clock->epoch + 2)) {
         return Error_InvalidLeaveEpoch;
     }
 
     // Set the leave epoch
+    const uint64_t old_leave_epoch = manager_account_state->leave_epoch;
+
     manager_account_state->leave_epoch = instruction_data->leave_epoch;
 
-    return 0;
+    return log_event(params, sysvars, 0, &old_leave_epoch, sizeof(old_leave_epoch),
+                     &(manager_account_state->leave_epoch), sizeof(manager_account_state->leave_epoch));
 }
 
 
 // Processes a Leave instruction.  Note that entrypoint already guaranteed that the manager_account exists as a
 // manager account already, and that vote_account has data and is owned by the vote program, and that manager_account
 // is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   withdraw_authority,            ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(3,   recipient_account,             ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(4,   vote_program_id,               ReadOnly,   NotSigner,  KnownAccount_VoteProgram);
-        DECLARE_ACCOUNT(5,   clock_sysvar,                  ReadOnly,   NotSigner,  KnownAccount_ClockSysvar);
-    }
-    DECLARE_ACCOUNTS_NUMBER(6);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_Leave]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *withdraw_authority = &(params->ka[2]);
+    SolAccountInfo *recipient_account = &(params->ka[3]);
+    SolAccountInfo *vote_program_id = &(params->ka[4]);
+    SolAccountInfo *clock_sysvar = &(params->ka[5]);
 
     // This is the vote account manager state
-    const VoteAccountManagerState *manager_account_state = (const VoteAccountManagerState *) manager_account->data;
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided withdraw authority is the withdraw authority that was saved in the manager account
-    if (!SolPubkey_same(&(manager_account_state->withdraw_authority), withdraw_authority->key)) {
+    if (!pubkey_equal(&(manager_account_state->withdraw_authority), withdraw_authority->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
@@ -1110,12 +2465,12 @@ static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds
             return Error_LeaveEpochNotSet;
         }
 
-        Clock clock;
-        if (sol_get_clock_sysvar(&clock)) {
+        const Clock *clock = get_clock(sysvars);
+        if (!clock) {
             return Error_FailedToGetClock;
         }
 
-        if (clock.epoch < manager_account_state->leave_epoch) {
+        if (clock->epoch < manager_account_state->leave_epoch) {
             return Error_CannotLeaveYet;
         }
     }
@@ -1136,20 +2491,34 @@ static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds
     instruction.accounts = account_metas;
     instruction.account_len = ARRAY_LEN(account_metas);
 
-    VoteAuthorizeData data = { 1, manager_account_state->withdraw_authority, 1 };
+    VoteAuthorizeData data;
+    data.enum_index = 1;
+    pubkey_copy(&(data.pubkey), &(manager_account_state->withdraw_authority));
+    data.authorize = 1;
 
     instruction.data = (uint8_t *) &data;
     instruction.data_len = sizeof(data);
 
+    PROFILE("handler");
     uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("cpi vote authorize");
     if (ret) {
         return ret;
     }
 
     // Now return all lamports from the manager account to the recipient account
-    *(recipient_account->lamports) += *(manager_account->lamports);
+    const uint64_t returned_lamports = *(manager_account->lamports);
+
+    *(recipient_account->lamports) += returned_lamports;
     *(manager_account->lamports) = 0;
 
+    // Log the event before the manager account contents that it includes are removed
+    ret = log_event(params, sysvars, returned_lamports, manager_account_state, sizeof(*manager_account_state),
+                    &(manager_account_state->withdraw_authority), sizeof(SolPubkey));
+    if (ret) {
+        return ret;
+    }
+
     // Dealloc the account data so that any subsequent instruction in the transaction referencing the account finds
     // no data
     ((uint64_t *) (manager_account->data))[-1] = 0;
@@ -1162,119 +2531,123 @@ static uint64_t process_leave(const SolParameters *params, const SolSignerSeeds
 // Processes a SetAdministrator instruction.  Note that entrypoint already guaranteed that the manager_account exists
 // as a manager account already, and that vote_account has data and is owned by the vote program, and that
 // manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_administrator(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_set_administrator(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                          SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   withdraw_authority,            ReadOnly,   Signer,     KnownAccount_NotKnown);
-    }
-    DECLARE_ACCOUNTS_NUMBER(3);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetAdministrator]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *withdraw_authority = &(params->ka[2]);
 
     // instruction_data will be set to the input data if it is of the correct size
     DECLARE_DATA(SetAuthorityInstructionData, instruction_data);
 
     // This is the vote account manager state
-    VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided withdraw authority is the withdraw authority that was saved in the manager account
-    if (!SolPubkey_same(&(manager_account_state->withdraw_authority), withdraw_authority->key)) {
+    if (!pubkey_equal(&(manager_account_state->withdraw_authority), withdraw_authority->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
     // Overwrite the administrator pubkey
-    manager_account_state->administrator = instruction_data->authority;
+    SolPubkey old_authority;
+    pubkey_copy(&old_authority, &(manager_account_state->administrator));
 
-    return 0;
+    pubkey_copy(&(manager_account_state->administrator), &(instruction_data->authority));
+
+    return log_event(params, sysvars, 0, &old_authority, sizeof(old_authority), &(instruction_data->authority),
+                     sizeof(SolPubkey));
 }
 
 
 // Processes a SetOperationalAuthority instruction.  Note that entrypoint already guaranteed that the manager_account
 // exists as a manager account already, and that vote_account has data and is owned by the vote program, and that
 // manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_operational_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_set_operational_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                                  SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   administrator,                 ReadOnly,   Signer,     KnownAccount_NotKnown);
-    }
-    DECLARE_ACCOUNTS_NUMBER(3);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetOperationalAuthority]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *administrator = &(params->ka[2]);
 
     // instruction_data will be set to the input data if it is of the correct size
     DECLARE_DATA(SetAuthorityInstructionData, instruction_data);
 
     // This is the vote account manager state
-    VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided administrator is the administrator that was saved in the manager account
-    if (!SolPubkey_same(&(manager_account_state->administrator), administrator->key)) {
+    if (!pubkey_equal(&(manager_account_state->administrator), administrator->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
     // Overwrite the operational authority pubkey
-    manager_account_state->operational_authority = instruction_data->authority;
+    SolPubkey old_authority;
+    pubkey_copy(&old_authority, &(manager_account_state->operational_authority));
 
-    return 0;
+    pubkey_copy(&(manager_account_state->operational_authority), &(instruction_data->authority));
+
+    return log_event(params, sysvars, 0, &old_authority, sizeof(old_authority), &(instruction_data->authority),
+                     sizeof(SolPubkey));
 }
 
 
 // Processes a SetRewardsAuthority instruction.  Note that entrypoint already guaranteed that the manager_account
 // exists as a manager account already, and that vote_account has data and is owned by the vote program, and that
 // manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_rewards_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_set_rewards_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                              SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   administrator,                 ReadOnly,   Signer,     KnownAccount_NotKnown);
-    }
-    DECLARE_ACCOUNTS_NUMBER(3);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetRewardsAuthority]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *administrator = &(params->ka[2]);
 
     // instruction_data will be set to the input data if it is of the correct size
     DECLARE_DATA(SetAuthorityInstructionData, instruction_data);
 
     // This is the vote account manager state
-    VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided administrator is the administrator that was saved in the manager account
-    if (!SolPubkey_same(&(manager_account_state->administrator), administrator->key)) {
+    if (!pubkey_equal(&(manager_account_state->administrator), administrator->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
     // Overwrite the rewards authority pubkey
-    manager_account_state->rewards_authority = instruction_data->authority;
+    SolPubkey old_authority;
+    pubkey_copy(&old_authority, &(manager_account_state->rewards_authority));
 
-    return 0;
+    pubkey_copy(&(manager_account_state->rewards_authority), &(instruction_data->authority));
+
+    return log_event(params, sysvars, 0, &old_authority, sizeof(old_authority), &(instruction_data->authority),
+                     sizeof(SolPubkey));
 }
 
 
 // Processes a SetVoteAuthority instruction.  Note that entrypoint already guaranteed that the manager_account exists
 // as a manager account already, and that vote_account has data and is owned by the vote program, and that
 // manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_vote_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_set_vote_authority(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                           SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   operational_authority,         ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(3,   vote_program_id,               ReadOnly,   NotSigner,  KnownAccount_VoteProgram);
-        DECLARE_ACCOUNT(4,   clock_sysvar,                  ReadOnly,   NotSigner,  KnownAccount_ClockSysvar);
-    }
-    DECLARE_ACCOUNTS_NUMBER(5);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetVoteAuthority]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *operational_authority = &(params->ka[2]);
+    SolAccountInfo *vote_program_id = &(params->ka[3]);
+    SolAccountInfo *clock_sysvar = &(params->ka[4]);
 
     // instruction_data will be set to the input data if it is of the correct size
     DECLARE_DATA(SetAuthorityInstructionData, instruction_data);
 
     // This is the vote account manager state
-    VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided operational authority is the operational authority of the manager account
-    if (!SolPubkey_same(&(manager_account_state->operational_authority), operational_authority->key)) {
+    if (!pubkey_equal(&(manager_account_state->operational_authority), operational_authority->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
@@ -1294,35 +2667,45 @@ static uint64_t process_set_vote_authority(const SolParameters *params, const So
     instruction.accounts = account_metas;
     instruction.account_len = ARRAY_LEN(account_metas);
 
-    VoteAuthorizeData data = { 1, instruction_data->authority, 0 };
+    VoteAuthorizeData data;
+    data.enum_index = 1;
+    pubkey_copy(&(data.pubkey), &(instruction_data->authority));
+    data.authorize = 0;
 
     instruction.data = (uint8_t *) &data;
     instruction.data_len = sizeof(data);
 
-    return sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("handler");
+    uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("cpi vote authorize");
+    if (ret) {
+        return ret;
+    }
+
+    // The vote authority being replaced is not known without decoding the vote account's authorized voters, so it is
+    // not logged
+    return log_event(params, sysvars, 0, 0, 0, &(instruction_data->authority), sizeof(SolPubkey));
 }
 
 
 // Processes a SetValidatorIdentity instruction.  Note that entrypoint already guaranteed that the manager_account
 // exists as a manager account already, and that vote_account has data and is owned by the vote program, and that
 // manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_validator_identity(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+static uint64_t process_set_validator_identity(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                               SysvarCache *sysvars)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   operational_authority,         ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(3,   new_validator_identity,        ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(4,   vote_program_id,               ReadOnly,   NotSigner,  KnownAccount_VoteProgram);
-    }
-    DECLARE_ACCOUNTS_NUMBER(5);
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetValidatorIdentity]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *operational_authority = &(params->ka[2]);
+    SolAccountInfo *new_validator_identity = &(params->ka[3]);
+    SolAccountInfo *vote_program_id = &(params->ka[4]);
 
     // This is the vote account manager state
-    const VoteAccountManagerState *manager_account_state = (const VoteAccountManagerState *) manager_account->data;
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided operational authority is the operational authority of the manager account
-    if (!SolPubkey_same(&(manager_account_state->operational_authority), operational_authority->key)) {
+    if (!pubkey_equal(&(manager_account_state->operational_authority), operational_authority->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
@@ -1347,78 +2730,105 @@ static uint64_t process_set_validator_identity(const SolParameters *params, cons
     instruction.data = (uint8_t *) &data;
     instruction.data_len = sizeof(data);
 
-    return sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    // The validator identity being replaced, copied out of the vote account before the vote program overwrites it.
+    // It is logged as empty if the vote account version is unknown.
+    SolPubkey old_validator_identity;
+    uint64_t old_validator_identity_len = 0;
+    VoteStateFields vote_state;
+    if (parse_vote_state(vote_account, &vote_state)) {
+        pubkey_copy(&old_validator_identity, vote_state.node_pubkey);
+        old_validator_identity_len = sizeof(old_validator_identity);
+    }
+
+    PROFILE("handler");
+    uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("cpi vote update_validator_identity");
+    if (ret) {
+        return ret;
+    }
+
+    return log_event(params, sysvars, 0, &old_validator_identity, old_validator_identity_len,
+                     new_validator_identity->key, sizeof(SolPubkey));
 }
 
 
-// Processes a Withdraw instruction.  Note that entrypoint already guaranteed that the manager_account exists as a
-// manager account already, and that vote_account has data and is owned by the vote program, and that manager_account
-// is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_withdraw(const SolParameters *params, const SolSignerSeeds *signer_seeds)
+// Withdraws lamports from the vote account (params->ka[1]) of the manager account (params->ka[0]) to recipient_account,
+// paying each recipient of the manager account's revenue split its share.  The recipients of the revenue split must be
+// the accounts from split_accounts_index on, and no other accounts may follow them.  If lamports is 0, then all
+// available lamports are withdrawn.  Fails with Error_InsufficientLamports if fewer than minimum_lamports, or no
+// lamports at all, would be withdrawn.
+static uint64_t withdraw_from_vote_account(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                           SysvarCache *sysvars, SolAccountInfo *recipient_account,
+                                           uint64_t split_accounts_index, uint64_t lamports, uint64_t minimum_lamports)
 {
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadOnly,   NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   rewards_authority,             ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(3,   recipient_account,             ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(4,   vote_program_id,               ReadOnly,   NotSigner,  KnownAccount_VoteProgram);
-    }
-    DECLARE_ACCOUNTS_NUMBER(5);
-
-    // instruction_data will be set to the input data if it is of the correct size
-    DECLARE_DATA(WithdrawInstructionData, instruction_data);
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
 
-    // This is the vote account manager state
-    const VoteAccountManagerState *manager_account_state = (const VoteAccountManagerState *) manager_account->data;
+    // If there is a revenue split, its recipients must follow, in order, and the manager account must be writable so
+    // that the withdrawn lamports can be paid out of it
+    const RevenueSplit *revenue_split = get_revenue_split(manager_account);
+    const uint8_t recipient_count = revenue_split ? revenue_split->recipient_count : 0;
 
-    // Ensure that the provided rewards authority is the rewards authority of the manager account
-    if (!SolPubkey_same(&(manager_account_state->rewards_authority), rewards_authority->key)) {
-        return Error_InvalidAccount_First + 2;
+    if (params->ka_num != (split_accounts_index + recipient_count)) {
+        return Error_IncorrectNumberOfAccounts;
     }
 
-    // Compute maximum lamports that may be withdrawn from the vote account
-    uint64_t maximum_allowed_lamports = 0;
-    // The maximum size of a vote account is 3762, as declared by the VoteState::sizeof_of() Rust function
-    uint64_t rent_exempt_minimum = get_rent_exempt_minimum(3762);
+    if (recipient_count > 0) {
+        if (!manager_account->is_writable) {
+            return Error_InvalidAccountPermissions_First;
+        }
 
-    if (*(vote_account->lamports) > rent_exempt_minimum) {
-        maximum_allowed_lamports = *(vote_account->lamports) - rent_exempt_minimum;
+        for (uint8_t i = 0; i < recipient_count; i++) {
+            const SolAccountInfo *recipient = &(params->ka[split_accounts_index + i]);
+            if (!pubkey_equal(recipient->key, &(revenue_split->recipients[i].recipient))) {
+                return Error_InvalidAccount_First + split_accounts_index + i;
+            }
+            if (!recipient->is_writable) {
+                return Error_InvalidAccountPermissions_First + split_accounts_index + i;
+            }
+        }
     }
 
+    // Compute maximum lamports that may be withdrawn from the vote account
+    uint64_t maximum_allowed_lamports = get_vote_account_withdrawable_lamports(sysvars, vote_account);
+
     // Compute lamports to withdraw
     uint64_t lamports_to_withdraw;
 
     // If the number of lamports to withdraw was not specified, the maximum that can be withdrawn is used
-    if (instruction_data->lamports == 0) {
+    if (lamports == 0) {
         lamports_to_withdraw = maximum_allowed_lamports;
     }
     // Else if the requested lamports withdraw is too large, then return an error
-    else if (instruction_data->lamports > maximum_allowed_lamports) {
+    else if (lamports > maximum_allowed_lamports) {
         return Error_InsufficientLamports;
     }
     // Else, withdraw the requested lamports, since it is specified and valid
     else {
-        lamports_to_withdraw = instruction_data->lamports;
+        lamports_to_withdraw = lamports;
     }
 
     // If lamports_to_withdraw is 0, then return an error.  This allows attempting to issue a withdraw without first
     // ensuring that there are no rewards to withdraw, when then fails in simulate, preventing any tx fee from being
-    // paid for a no-op
-    if (lamports_to_withdraw == 0) {
+    // paid for a no-op.  Likewise for fewer than minimum_lamports, so that a Sweep which would withdraw too little to
+    // be worth its fee fails in simulate.
+    if ((lamports_to_withdraw == 0) || (lamports_to_withdraw < minimum_lamports)) {
         return Error_InsufficientLamports;
     }
 
-    // Issue a vote withdraw instruction to withdraw the lamports from the vote account
+    // Issue a vote withdraw instruction to withdraw the lamports from the vote account, into the manager account if
+    // they are to be split, otherwise directly to the recipient account
     SolInstruction instruction;
 
     instruction.program_id = &(Constants.vote_program_pubkey);
 
+    const SolAccountInfo *destination_account = (recipient_count > 0) ? manager_account : recipient_account;
+
     SolAccountMeta account_metas[] =
           ///   0. `[WRITE]` Vote account to be updated with the Pubkey for authorization
         { { /* pubkey */ vote_account->key, /* is_writable */ true, /* is_signer */ false },
           ///   1. `[WRITE]` Recipient account
-          { /* pubkey */ recipient_account->key, /* is_writable */ true, /* is_signer */ false },
+          { /* pubkey */ destination_account->key, /* is_writable */ true, /* is_signer */ false },
           ///   2. `[SIGNER]` Withdraw authority
           { /* pubkey */ manager_account->key, /* is_writable */ false, /* is_signer */ true } };
 
@@ -1430,35 +2840,123 @@ static uint64_t process_withdraw(const SolParameters *params, const SolSignerSee
     instruction.data = (uint8_t *) &data;
     instruction.data_len = sizeof(data);
 
-    return sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
-}
+    PROFILE("handler");
+    uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("cpi vote withdraw");
+    if (ret) {
+        return ret;
+    }
 
+    // Pay each recipient its share directly out of the manager account, which this program owns, and the recipient
+    // account whatever remains.  Each share is computed in two parts so that the product cannot overflow.  A share
+    // that would leave its recipient short of rent exemption, as when the recipient is a new or emptied account, would
+    // fail the transaction, and with it every Withdraw and Sweep until the revenue split is changed; such a share is
+    // instead carried over to the recipient account.
+    if (recipient_count > 0) {
+        uint64_t remaining_lamports = lamports_to_withdraw;
+
+        for (uint8_t i = 0; i < recipient_count; i++) {
+            SolAccountInfo *recipient = &(params->ka[split_accounts_index + i]);
+            uint64_t share_bps = revenue_split->recipients[i].share_bps;
+            uint64_t share = (((lamports_to_withdraw / 10000) * share_bps) +
+                              (((lamports_to_withdraw % 10000) * share_bps) / 10000));
+            if ((*(recipient->lamports) + share) <
+                compute_rent_exempt_minimum(get_rent(sysvars), recipient->data_len)) {
+                continue;
+            }
+            *(recipient->lamports) += share;
+            remaining_lamports -= share;
+        }
 
-// Processes a SetCommission instruction.  Note that entrypoint already guaranteed that the manager_account exists as
-// a manager account already, and that vote_account has data and is owned by the vote program, and that
-// manager_account is the correct Vote Account Manager state account for vote_account.
-static uint64_t process_set_commission(const SolParameters *params, const SolSignerSeeds *signer_seeds)
-{
-    // Declare accounts, which checks the permissions of all accounts, and the identity of known accounts
-    DECLARE_ACCOUNTS {
-        DECLARE_ACCOUNT(0,   manager_account,               ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(1,   vote_account,                  ReadWrite,  NotSigner,  KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(2,   rewards_authority,             ReadOnly,   Signer,     KnownAccount_NotKnown);
-        DECLARE_ACCOUNT(3,   vote_program_id,               ReadOnly,   NotSigner,  KnownAccount_VoteProgram);
+        *(recipient_account->lamports) += remaining_lamports;
+        *(manager_account->lamports) -= lamports_to_withdraw;
     }
-    DECLARE_ACCOUNTS_NUMBER(4);
+
+    sol_set_return_data((const uint8_t *) &lamports_to_withdraw, sizeof(lamports_to_withdraw));
+
+    return log_event(params, sysvars, lamports_to_withdraw, 0, 0, recipient_account->key, sizeof(SolPubkey));
+}
+
+
+// Processes a Withdraw instruction.  Note that entrypoint already guaranteed that the manager_account exists as a
+// manager account already, and that vote_account has data and is owned by the vote program, and that manager_account
+// is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_withdraw(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_Withdraw]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *rewards_authority = &(params->ka[2]);
+    SolAccountInfo *recipient_account = &(params->ka[3]);
+    SolAccountInfo *vote_program_id = &(params->ka[4]);
 
     // instruction_data will be set to the input data if it is of the correct size
-    DECLARE_DATA(SetCommissionInstructionData, instruction_data);
+    DECLARE_DATA(WithdrawInstructionData, instruction_data);
 
     // This is the vote account manager state
-    VoteAccountManagerState *manager_account_state = (VoteAccountManagerState *) manager_account->data;
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
 
     // Ensure that the provided rewards authority is the rewards authority of the manager account
-    if (!SolPubkey_same(&(manager_account_state->rewards_authority), rewards_authority->key)) {
+    if (!pubkey_equal(&(manager_account_state->rewards_authority), rewards_authority->key)) {
         return Error_InvalidAccount_First + 2;
     }
 
+    return withdraw_from_vote_account(params, signer_seeds, sysvars, recipient_account, 5, instruction_data->lamports,
+                                      0);
+}
+
+
+// Returns the largest commission that SetCommission would allow to be set in epoch for a vote account with the given
+// manager account state and commission
+static uint8_t compute_max_allowed_commission(const VoteAccountManagerState *manager_account_state,
+                                              uint8_t commission, uint64_t epoch)
+{
+    if (!manager_account_state->use_commission_caps) {
+        return 100;
+    }
+
+    // Once the leave epoch is set, commission can never be changed
+    if (manager_account_state->leave_epoch > 0) {
+        return commission;
+    }
+
+    // Increases are limited relative to the commission that was in effect before the first change in the epoch
+    uint8_t base_commission = commission;
+    if (manager_account_state->commission_change_epoch == epoch) {
+        base_commission = manager_account_state->commission_change_epoch_original_commission;
+    }
+
+    uint8_t max_allowed_commission = base_commission + manager_account_state->max_commission_increase_per_epoch;
+
+    if (max_allowed_commission > manager_account_state->max_commission) {
+        max_allowed_commission = manager_account_state->max_commission;
+    }
+
+    return (max_allowed_commission > 100) ? 100 : max_allowed_commission;
+}
+
+
+// Sets the commission of the vote account (params->ka[1]) of the writable manager account (params->ka[0]), enforcing
+// the commission caps of the manager account if they are in use
+static uint64_t set_vote_account_commission(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                            SysvarCache *sysvars, uint8_t commission)
+{
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+
+    // This is the vote account manager state
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    // The commission being replaced.  This is the commission actually in the vote account, which should never differ
+    // from current_commission, because only this program can change the commission of a managed vote account, but if
+    // they do, the vote account's value is the correct one.  If the vote account version is unknown, the stored value
+    // is used.
+    uint8_t old_commission = manager_account_state->current_commission;
+    VoteStateFields vote_state;
+    if (parse_vote_state(vote_account, &vote_state)) {
+        old_commission = vote_state.commission;
+    }
+
     // If commission caps are being enforced, then check to make sure that there are no violations
     if (manager_account_state->use_commission_caps) {
         // First, if there is a leave_epoch set, then it is not possible to change commission at all, ever
@@ -1467,19 +2965,23 @@ static uint64_t process_set_commission(const SolParameters *params, const SolSig
         }
 
         // Next, ensure that the commission is not greater than the max allowed commission
-        if (instruction_data->commission > manager_account_state->max_commission) {
+        if (commission > manager_account_state->max_commission) {
             return Error_CommissionTooLarge;
         }
 
-        Clock clock;
-        if (sol_get_clock_sysvar(&clock)) {
+        const Clock *clock = get_clock(sysvars);
+        if (!clock) {
             return Error_FailedToGetClock;
         }
 
+        // current_commission is the basis of the commission increase limit, so correct it if it has diverged from
+        // the vote account
+        manager_account_state->current_commission = old_commission;
+
         // If the commission change epoch is less than the current epoch, then set commission_change_epoch and
         // commission_change_epoch_original_commission.
-        if (manager_account_state->commission_change_epoch < clock.epoch) {
-            manager_account_state->commission_change_epoch = clock.epoch;
+        if (manager_account_state->commission_change_epoch < clock->epoch) {
+            manager_account_state->commission_change_epoch = clock->epoch;
             manager_account_state->commission_change_epoch_original_commission =
                 manager_account_state->current_commission;
         }
@@ -1492,12 +2994,12 @@ static uint64_t process_set_commission(const SolParameters *params, const SolSig
             max_allowed_commission = 100;
         }
 
-        if (instruction_data->commission > max_allowed_commission) {
+        if (commission > max_allowed_commission) {
             return Error_CommissionChangeTooLarge;
         }
 
         // The new commission is allowable, so update the data
-        manager_account_state->current_commission = instruction_data->commission;
+        manager_account_state->current_commission = commission;
     }
 
     // Issue a vote update commission instruction to set the commission of the vote account
@@ -1514,10 +3016,762 @@ static uint64_t process_set_commission(const SolParameters *params, const SolSig
     instruction.accounts = account_metas;
     instruction.account_len = ARRAY_LEN(account_metas);
 
-    VoteUpdateCommissionData data = { 5, instruction_data->commission };
+    VoteUpdateCommissionData data = { 5, commission };
 
     instruction.data = (uint8_t *) &data;
     instruction.data_len = sizeof(data);
 
-    return sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("handler");
+    uint64_t ret = sol_invoke_signed(&instruction, params->ka, params->ka_num, signer_seeds, 1);
+    PROFILE("cpi vote update_commission");
+    if (ret) {
+        return ret;
+    }
+
+    const Clock *clock = get_clock(sysvars);
+    if (!clock) {
+        return Error_FailedToGetClock;
+    }
+
+    CommissionReturnData return_data;
+    return_data.commission = commission;
+    return_data.max_allowed_commission = compute_max_allowed_commission(manager_account_state, commission,
+                                                                        clock->epoch);
+
+    sol_set_return_data((const uint8_t *) &return_data, sizeof(return_data));
+
+    return log_event(params, sysvars, 0, &old_commission, sizeof(old_commission), &commission, sizeof(commission));
+}
+
+
+// Processes a SetCommission instruction.  Note that entrypoint already guaranteed that the manager_account exists as
+// a manager account already, and that vote_account has data and is owned by the vote program, and that
+// manager_account is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_set_commission(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                       SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetCommission]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *rewards_authority = &(params->ka[2]);
+    SolAccountInfo *vote_program_id = &(params->ka[3]);
+
+    // instruction_data will be set to the input data if it is of the correct size
+    DECLARE_DATA(SetCommissionInstructionData, instruction_data);
+
+    // This is the vote account manager state
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    // Ensure that the provided rewards authority is the rewards authority of the manager account
+    if (!pubkey_equal(&(manager_account_state->rewards_authority), rewards_authority->key)) {
+        return Error_InvalidAccount_First + 2;
+    }
+
+    return set_vote_account_commission(params, signer_seeds, sysvars, instruction_data->commission);
+}
+
+
+// Processes a Batch instruction.  Note that entrypoint already guaranteed that the manager_account exists as a manager
+// account already, and that vote_account has data and is owned by the vote program, and that manager_account is the
+// correct Vote Account Manager state account for vote_account.  Because every operation must use the same
+// manager_account and vote_account, these guarantees hold for every operation.
+static uint64_t process_batch(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
+{
+    if (params->data_len < sizeof(BatchInstructionData)) {
+        return Error_InvalidDataSize;
+    }
+
+    const BatchInstructionData *instruction_data = (const BatchInstructionData *) params->data;
+
+    const uint8_t *data = params->data + sizeof(BatchInstructionData);
+    const uint8_t *data_end = params->data + params->data_len;
+
+    // Each operation is given its own parameters, with the accounts and data that it would have had if it were issued
+    // as a separate instruction.  The data is copied so that it is correctly aligned.  A Withdraw from a vote account
+    // with a revenue split has the most accounts of any operation that may be batched.
+    SolAccountInfo operation_account_info[5 + MANAGER_STATE_REVENUE_SPLIT_MAX_RECIPIENTS];
+    uint64_t operation_data[8];
+
+    SolParameters operation_params;
+    operation_params.ka = operation_account_info;
+    operation_params.data = (const uint8_t *) operation_data;
+    operation_params.program_id = params->program_id;
+
+    for (uint8_t i = 0; i < instruction_data->operation_count; i++) {
+        if ((uint64_t) (data_end - data) < sizeof(BatchOperationHeader)) {
+            return Error_InvalidDataSize;
+        }
+
+        const BatchOperationHeader *header = (const BatchOperationHeader *) data;
+        data += sizeof(BatchOperationHeader);
+
+        if ((header->account_count > ARRAY_LEN(operation_account_info)) || (header->data_len == 0) ||
+            (header->data_len > sizeof(operation_data)) ||
+            ((uint64_t) (data_end - data) < ((uint64_t) header->account_count + header->data_len))) {
+            return Error_InvalidDataSize;
+        }
+
+        // The operation must use the manager account and vote account that entrypoint verified
+        if (header->account_count < 2) {
+            return Error_IncorrectNumberOfAccounts;
+        }
+        if (data[0] != 0) {
+            return Error_InvalidAccount_First;
+        }
+        if (data[1] != 1) {
+            return Error_InvalidAccount_First + 1;
+        }
+
+        for (uint8_t j = 0; j < header->account_count; j++) {
+            if (data[j] >= params->ka_num) {
+                return Error_IncorrectNumberOfAccounts;
+            }
+            operation_account_info[j] = params->ka[data[j]];
+        }
+        operation_params.ka_num = header->account_count;
+        data += header->account_count;
+
+        sol_memcpy(operation_data, data, header->data_len);
+        operation_params.data_len = header->data_len;
+        data += header->data_len;
+
+        // Only the instructions from SetAdministrator through SetCommission may be batched; the others create or
+        // destroy the manager account, or take a variable number of accounts
+        const uint8_t operation_code = operation_params.data[0];
+        if ((operation_code < Instruction_SetAdministrator) || (operation_code > Instruction_SetCommission)) {
+            return Error_InstructionNotAllowedInBatch;
+        }
+
+        PROFILE("handler");
+        uint64_t ret = check_accounts(&operation_params, operation_code);
+        if (ret) {
+            return ret;
+        }
+        PROFILE("accounts");
+
+        // Clear the return data of any previous operation, so that the instruction's return data is that of its last
+        // operation only
+        sol_set_return_data(0, 0);
+
+        switch (operation_code) {
+        case Instruction_SetAdministrator:
+            ret = process_set_administrator(&operation_params, signer_seeds, sysvars);
+            break;
+
+        case Instruction_SetOperationalAuthority:
+            ret = process_set_operational_authority(&operation_params, signer_seeds, sysvars);
+            break;
+
+        case Instruction_SetRewardsAuthority:
+            ret = process_set_rewards_authority(&operation_params, signer_seeds, sysvars);
+            break;
+
+        case Instruction_SetVoteAuthority:
+            ret = process_set_vote_authority(&operation_params, signer_seeds, sysvars);
+            break;
+
+        case Instruction_SetValidatorIdentity:
+            ret = process_set_validator_identity(&operation_params, signer_seeds, sysvars);
+            break;
+
+        case Instruction_Withdraw:
+            ret = process_withdraw(&operation_params, signer_seeds, sysvars);
+            break;
+
+        case Instruction_SetCommission:
+            ret = process_set_commission(&operation_params, signer_seeds, sysvars);
+            break;
+
+        default:
+            return Error_InstructionNotAllowedInBatch;
+        }
+
+        if (ret) {
+            return ret;
+        }
+    }
+
+    // All of the instruction data must have been consumed by the operations
+    if (data != data_end) {
+        return Error_InvalidDataSize;
+    }
+
+    return 0;
+}
+
+
+// Processes a FleetWithdraw or FleetSetCommission instruction.  Note that entrypoint already guaranteed that the first
+// manager_account exists as a manager account already, and that the first vote_account has data and is owned by the
+// vote program, and that the first manager_account is the correct Vote Account Manager state account for the first
+// vote_account.  The additional pairs of manager account and vote account are verified here in the same way.  Each
+// pair is then processed exactly as a Withdraw or SetCommission instruction for that vote account would be, using the
+// accounts that follow the first pair.
+static uint64_t process_fleet(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
+{
+    const bool is_withdraw = (params->data[0] == Instruction_FleetWithdraw);
+
+    // The accounts following the first pair that are shared by every pair: the rewards authority, the recipient
+    // account for FleetWithdraw only, and the vote program id
+    const uint64_t common_account_count = is_withdraw ? 3 : 2;
+
+    // Index of the manager account of the first additional pair
+    const uint64_t additional_pairs_index = 2 + common_account_count;
+
+    if ((params->ka_num < additional_pairs_index) || ((params->ka_num - additional_pairs_index) % 2)) {
+        return Error_IncorrectNumberOfAccounts;
+    }
+
+    // Each pair is given its own parameters, with the accounts and data that a Withdraw or SetCommission instruction
+    // for the pair's vote account would have had
+    SolAccountInfo operation_account_info[5];
+    sol_memcpy(&(operation_account_info[2]), &(params->ka[2]), common_account_count * sizeof(SolAccountInfo));
+
+    WithdrawInstructionData withdraw_data = { Instruction_Withdraw, 0 };
+    SetCommissionInstructionData set_commission_data = { Instruction_SetCommission, 0 };
+
+    SolParameters operation_params;
+    operation_params.ka = operation_account_info;
+    operation_params.ka_num = 2 + common_account_count;
+    operation_params.program_id = params->program_id;
+
+    if (is_withdraw) {
+        if (params->data_len != 1) {
+            return Error_InvalidDataSize;
+        }
+        operation_params.data = (const uint8_t *) &withdraw_data;
+        operation_params.data_len = sizeof(withdraw_data);
+    }
+    else {
+        DECLARE_DATA(SetCommissionInstructionData, instruction_data);
+        set_commission_data.commission = instruction_data->commission;
+        operation_params.data = (const uint8_t *) &set_commission_data;
+        operation_params.data_len = sizeof(set_commission_data);
+    }
+
+    // Signer seeds of the additional pairs
+    uint8_t bump_seed;
+    SolSignerSeed seeds[] = { { 0, sizeof(SolPubkey) }, { (const uint8_t *) &bump_seed, sizeof(bump_seed) } };
+    SolSignerSeeds pair_signer_seeds = { seeds, ARRAY_LEN(seeds) };
+
+    // Number of vote accounts from which lamports were withdrawn, and the total lamports withdrawn from them
+    uint64_t withdrawn_count = 0;
+    uint64_t withdrawn_lamports = 0;
+
+    uint64_t manager_account_index = 0;
+
+    while (manager_account_index < params->ka_num) {
+        SolAccountInfo *manager_account = &(params->ka[manager_account_index]);
+        const SolAccountInfo *vote_account = &(params->ka[manager_account_index + 1]);
+
+        const SolSignerSeeds *operation_signer_seeds = signer_seeds;
+
+        if (manager_account_index > 0) {
+            PROFILE("handler");
+            uint64_t ret = verify_manager_account(manager_account, vote_account, manager_account_index, sysvars,
+                                                  &bump_seed);
+            if (ret) {
+                return ret;
+            }
+            PROFILE("pda");
+
+            // Check permissions here so that errors identify the account within this instruction
+            if (!is_withdraw && !manager_account->is_writable) {
+                return Error_InvalidAccountPermissions_First + manager_account_index;
+            }
+            if (!vote_account->is_writable) {
+                return Error_InvalidAccountPermissions_First + manager_account_index + 1;
+            }
+
+            seeds[0].addr = (const uint8_t *) vote_account->key;
+            operation_signer_seeds = &pair_signer_seeds;
+        }
+
+        operation_account_info[0] = *manager_account;
+        operation_account_info[1] = *vote_account;
+
+        // The first pair and the common accounts are at the same indices as in a Withdraw or SetCommission
+        // instruction, so check them against that instruction's schema, once.  The additional pairs were checked
+        // above.
+        if (manager_account_index == 0) {
+            uint64_t ret = check_accounts(&operation_params, operation_params.data[0]);
+            if (ret) {
+                return ret;
+            }
+        }
+
+        if (is_withdraw) {
+            uint64_t ret = process_withdraw(&operation_params, operation_signer_seeds, sysvars);
+            // A vote account with no lamports available to withdraw is skipped
+            if (ret == Error_InsufficientLamports) {
+                ret = 0;
+            }
+            else if (ret == 0) {
+                // The Withdraw returned the number of lamports that it withdrew
+                uint64_t lamports = 0;
+                SolPubkey program_id;
+                sol_get_return_data((uint8_t *) &lamports, sizeof(lamports), &program_id);
+
+                withdrawn_count++;
+                withdrawn_lamports += lamports;
+            }
+            if (ret) {
+                return ret;
+            }
+        }
+        else {
+            uint64_t ret = process_set_commission(&operation_params, operation_signer_seeds, sysvars);
+            if (ret) {
+                return ret;
+            }
+        }
+
+        manager_account_index = (manager_account_index == 0) ? additional_pairs_index : (manager_account_index + 2);
+    }
+
+    if (is_withdraw) {
+        // As with Withdraw, fail if nothing was withdrawn so that a no-op fails in simulation without paying a tx fee
+        if (withdrawn_count == 0) {
+            return Error_InsufficientLamports;
+        }
+
+        sol_set_return_data((const uint8_t *) &withdrawn_lamports, sizeof(withdrawn_lamports));
+    }
+
+    return 0;
+}
+
+
+// Processes a SetRevenueSplit instruction.  Note that entrypoint already guaranteed that the manager_account exists
+// as a manager account already, and that vote_account has data and is owned by the vote program, and that
+// manager_account is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_set_revenue_split(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                          SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetRevenueSplit]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *administrator = &(params->ka[2]);
+    SolAccountInfo *funding_account = &(params->ka[3]);
+    SolAccountInfo *system_program_id = &(params->ka[4]);
+
+    // The instruction data holds only the recipients in use
+    const uint64_t header_size = __builtin_offsetof(SetRevenueSplitInstructionData, revenue_split.recipients);
+
+    if (params->data_len < header_size) {
+        return Error_InvalidDataSize;
+    }
+
+    const SetRevenueSplitInstructionData *instruction_data = (const SetRevenueSplitInstructionData *) params->data;
+    const RevenueSplit *new_revenue_split = &(instruction_data->revenue_split);
+    const uint8_t recipient_count = new_revenue_split->recipient_count;
+
+    if ((recipient_count > MANAGER_STATE_REVENUE_SPLIT_MAX_RECIPIENTS) ||
+        (params->data_len != (header_size + (recipient_count * sizeof(RevenueSplitRecipient))))) {
+        return Error_InvalidDataSize;
+    }
+
+    // This is the vote account manager state
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    // Ensure that the provided administrator is the administrator that was saved in the manager account
+    if (!pubkey_equal(&(manager_account_state->administrator), administrator->key)) {
+        return Error_InvalidAccount_First + 2;
+    }
+
+    // Validate the new revenue split
+    uint64_t total_bps = 0;
+
+    for (uint8_t i = 0; i < recipient_count; i++) {
+        const RevenueSplitRecipient *recipient = &(new_revenue_split->recipients[i]);
+
+        if ((recipient->share_bps == 0) || pubkey_equal(&(recipient->recipient), manager_account->key) ||
+            pubkey_equal(&(recipient->recipient), vote_account->key)) {
+            return Error_InvalidRevenueSplit;
+        }
+
+        for (uint8_t j = 0; j < i; j++) {
+            if (pubkey_equal(&(recipient->recipient), &(new_revenue_split->recipients[j].recipient))) {
+                return Error_InvalidRevenueSplit;
+            }
+        }
+
+        total_bps += recipient->share_bps;
+    }
+
+    if (total_bps > 10000) {
+        return Error_InvalidRevenueSplit;
+    }
+
+    RevenueSplit *revenue_split = get_revenue_split(manager_account);
+
+    // The revenue split being replaced, copied so that it can be logged
+    RevenueSplit old_revenue_split;
+    uint64_t old_revenue_split_len = 0;
+
+    if (revenue_split) {
+        old_revenue_split_len = (__builtin_offsetof(RevenueSplit, recipients) +
+                                 (revenue_split->recipient_count * sizeof(RevenueSplitRecipient)));
+        sol_memcpy(&old_revenue_split, revenue_split, old_revenue_split_len);
+    }
+    else {
+        // Removing a revenue split that was never set does nothing
+        if (recipient_count == 0) {
+            return 0;
+        }
+
+        // Grow the manager account to hold the revenue split
+        uint64_t ret = grow_manager_account(params, funding_account, manager_account, sysvars,
+                                            MANAGER_STATE_REVENUE_SPLIT_END);
+        if (ret) {
+            return ret;
+        }
+
+        revenue_split = get_revenue_split(manager_account);
+    }
+
+    const uint64_t new_revenue_split_len = params->data_len - sizeof(instruction_data->instruction_index);
+
+    sol_memcpy(revenue_split, new_revenue_split, new_revenue_split_len);
+
+    return log_event(params, sysvars, 0, &old_revenue_split, old_revenue_split_len, revenue_split,
+                     new_revenue_split_len);
+}
+
+
+// Processes a SetSweep instruction.  Note that entrypoint already guaranteed that the manager_account exists as a
+// manager account already, and that vote_account has data and is owned by the vote program, and that manager_account
+// is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_set_sweep(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                  SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetSweep]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *rewards_authority = &(params->ka[2]);
+    SolAccountInfo *funding_account = &(params->ka[3]);
+    SolAccountInfo *system_program_id = &(params->ka[4]);
+
+    // instruction_data will be set to the input data if it is of the correct size
+    DECLARE_DATA(SetSweepInstructionData, instruction_data);
+
+    // This is the vote account manager state
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    // Ensure that the provided rewards authority is the rewards authority of the manager account
+    if (!pubkey_equal(&(manager_account_state->rewards_authority), rewards_authority->key)) {
+        return Error_InvalidAccount_First + 2;
+    }
+
+    Sweep *sweep = get_sweep(manager_account);
+
+    // The sweep being replaced, copied so that it can be logged
+    Sweep old_sweep;
+    uint64_t old_sweep_len = 0;
+
+    if (sweep) {
+        old_sweep = *sweep;
+        old_sweep_len = sizeof(old_sweep);
+    }
+    else {
+        // Disabling a sweep that was never set does nothing
+        if (pubkey_is_zero(&(instruction_data->recipient))) {
+            return 0;
+        }
+
+        // Grow the manager account to hold the sweep
+        uint64_t ret = grow_manager_account(params, funding_account, manager_account, sysvars,
+                                            MANAGER_STATE_SWEEP_END);
+        if (ret) {
+            return ret;
+        }
+
+        sweep = get_sweep(manager_account);
+    }
+
+    pubkey_copy(&(sweep->recipient), &(instruction_data->recipient));
+    sweep->minimum_lamports = instruction_data->minimum_lamports;
+
+    return log_event(params, sysvars, 0, &old_sweep, old_sweep_len, sweep, sizeof(*sweep));
+}
+
+
+// Processes a Sweep instruction.  Note that entrypoint already guaranteed that the manager_account exists as a
+// manager account already, and that vote_account has data and is owned by the vote program, and that manager_account
+// is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_sweep(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_Sweep]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *recipient_account = &(params->ka[2]);
+    SolAccountInfo *vote_program_id = &(params->ka[3]);
+
+    if (params->data_len != 1) {
+        return Error_InvalidDataSize;
+    }
+
+    // The sweep must be enabled, and the recipient account must be its recipient; this, rather than any signature,
+    // is what authorizes the withdraw
+    const Sweep *sweep = get_sweep(manager_account);
+
+    if (!sweep || pubkey_is_zero(&(sweep->recipient))) {
+        return Error_SweepNotSet;
+    }
+
+    if (!pubkey_equal(&(sweep->recipient), recipient_account->key)) {
+        return Error_InvalidAccount_First + 2;
+    }
+
+    return withdraw_from_vote_account(params, signer_seeds, sysvars, recipient_account, 4, 0,
+                                      sweep->minimum_lamports);
+}
+
+
+// Processes a SetCommissionSchedule instruction.  Note that entrypoint already guaranteed that the manager_account
+// exists as a manager account already, and that vote_account has data and is owned by the vote program, and that
+// manager_account is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_set_commission_schedule(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                                SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_SetCommissionSchedule]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *rewards_authority = &(params->ka[2]);
+    SolAccountInfo *funding_account = &(params->ka[3]);
+    SolAccountInfo *system_program_id = &(params->ka[4]);
+
+    // The instruction data holds only the steps in use
+    const uint64_t header_size = __builtin_offsetof(SetCommissionScheduleInstructionData, steps);
+
+    if (params->data_len < header_size) {
+        return Error_InvalidDataSize;
+    }
+
+    const SetCommissionScheduleInstructionData *instruction_data =
+        (const SetCommissionScheduleInstructionData *) params->data;
+    const uint8_t step_count = instruction_data->step_count;
+
+    if ((step_count > MANAGER_STATE_COMMISSION_SCHEDULE_MAX_STEPS) ||
+        (params->data_len != (header_size + (step_count * sizeof(CommissionScheduleStep))))) {
+        return Error_InvalidDataSize;
+    }
+
+    // This is the vote account manager state
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    // Ensure that the provided rewards authority is the rewards authority of the manager account
+    if (!pubkey_equal(&(manager_account_state->rewards_authority), rewards_authority->key)) {
+        return Error_InvalidAccount_First + 2;
+    }
+
+    // Validate the new schedule, checking each step against the commission caps as if it were applied in its epoch
+    if (step_count > 0) {
+        const Clock *clock = get_clock(sysvars);
+        if (!clock) {
+            return Error_FailedToGetClock;
+        }
+
+        if (manager_account_state->use_commission_caps && (manager_account_state->leave_epoch > 0)) {
+            return Error_LeaveEpochAlreadySet;
+        }
+
+        uint8_t previous_commission = manager_account_state->current_commission;
+        VoteStateFields vote_state;
+        if (parse_vote_state(vote_account, &vote_state)) {
+            previous_commission = vote_state.commission;
+        }
+
+        uint64_t minimum_epoch = clock->epoch;
+
+        for (uint8_t i = 0; i < step_count; i++) {
+            const CommissionScheduleStep *step = &(instruction_data->steps[i]);
+
+            if ((step->epoch < minimum_epoch) || (step->commission > 100)) {
+                return Error_InvalidCommissionSchedule;
+            }
+
+            if (manager_account_state->use_commission_caps) {
+                if (step->commission > manager_account_state->max_commission) {
+                    return Error_CommissionTooLarge;
+                }
+                if (step->commission > (previous_commission +
+                                        manager_account_state->max_commission_increase_per_epoch)) {
+                    return Error_CommissionChangeTooLarge;
+                }
+            }
+
+            previous_commission = step->commission;
+            minimum_epoch = step->epoch + 1;
+        }
+    }
+
+    CommissionSchedule *commission_schedule = get_commission_schedule(manager_account);
+
+    // The commission schedule being replaced, copied so that it can be logged
+    CommissionSchedule old_commission_schedule;
+    uint64_t old_commission_schedule_len = 0;
+
+    if (commission_schedule) {
+        old_commission_schedule_len = (__builtin_offsetof(CommissionSchedule, steps) +
+                                       (commission_schedule->step_count * sizeof(CommissionScheduleStep)));
+        sol_memcpy(&old_commission_schedule, commission_schedule, old_commission_schedule_len);
+    }
+    else {
+        // Removing a commission schedule that was never set does nothing
+        if (step_count == 0) {
+            return 0;
+        }
+
+        // Grow the manager account to hold the commission schedule
+        uint64_t ret = grow_manager_account(params, funding_account, manager_account, sysvars,
+                                            MANAGER_STATE_COMMISSION_SCHEDULE_END);
+        if (ret) {
+            return ret;
+        }
+
+        commission_schedule = get_commission_schedule(manager_account);
+    }
+
+    commission_schedule->step_count = step_count;
+    commission_schedule->next_step = 0;
+    sol_memcpy(commission_schedule->steps, instruction_data->steps, step_count * sizeof(CommissionScheduleStep));
+
+    return log_event(params, sysvars, 0, &old_commission_schedule, old_commission_schedule_len, commission_schedule,
+                     __builtin_offsetof(CommissionSchedule, steps) + (step_count * sizeof(CommissionScheduleStep)));
+}
+
+
+// Processes an ApplyCommissionSchedule instruction.  Note that entrypoint already guaranteed that the manager_account
+// exists as a manager account already, and that vote_account has data and is owned by the vote program, and that
+// manager_account is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_apply_commission_schedule(const SolParameters *params, const SolSignerSeeds *signer_seeds,
+                                                  SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_ApplyCommissionSchedule]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+    SolAccountInfo *vote_program_id = &(params->ka[2]);
+
+    if (params->data_len != 1) {
+        return Error_InvalidDataSize;
+    }
+
+    CommissionSchedule *commission_schedule = get_commission_schedule(manager_account);
+
+    if (!commission_schedule || (commission_schedule->next_step >= commission_schedule->step_count)) {
+        return Error_CommissionScheduleStepNotDue;
+    }
+
+    const CommissionScheduleStep *step = &(commission_schedule->steps[commission_schedule->next_step]);
+
+    const Clock *clock = get_clock(sysvars);
+    if (!clock) {
+        return Error_FailedToGetClock;
+    }
+
+    if (step->epoch > clock->epoch) {
+        return Error_CommissionScheduleStepNotDue;
+    }
+
+    // The schedule was checked against the commission caps when it was set, but SetCommission or SetLeaveEpoch may
+    // have changed things since.  A step that the caps would reject in this and every later epoch, because a leave
+    // epoch has been set or the step's commission is more than the max commission increase above the current
+    // commission, would block every step after it; it is skipped instead, logging the rejected step.
+    VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    if (manager_account_state->use_commission_caps) {
+        uint8_t commission = manager_account_state->current_commission;
+        VoteStateFields vote_state;
+        if (parse_vote_state(vote_account, &vote_state)) {
+            commission = vote_state.commission;
+        }
+
+        if ((manager_account_state->leave_epoch > 0) || (step->commission > manager_account_state->max_commission) ||
+            (step->commission > (commission + manager_account_state->max_commission_increase_per_epoch))) {
+            commission_schedule->next_step++;
+
+            CommissionReturnData return_data;
+            return_data.commission = commission;
+            return_data.max_allowed_commission = compute_max_allowed_commission(manager_account_state, commission,
+                                                                                clock->epoch);
+
+            sol_set_return_data((const uint8_t *) &return_data, sizeof(return_data));
+
+            return log_event(params, sysvars, 0, step, sizeof(*step), 0, 0);
+        }
+    }
+
+    // Otherwise the caps are enforced as usual, so that a step that exceeds only what remains of this epoch's max
+    // commission increase is applied late rather than skipped
+    uint64_t ret = set_vote_account_commission(params, signer_seeds, sysvars, step->commission);
+    if (ret) {
+        return ret;
+    }
+
+    commission_schedule->next_step++;
+
+    return 0;
+}
+
+
+// Processes a GetState instruction.  Note that entrypoint already guaranteed that the manager_account exists as a
+// manager account already, and that vote_account has data and is owned by the vote program, and that manager_account
+// is the correct Vote Account Manager state account for vote_account.
+static uint64_t process_get_state(const SolParameters *params, const SolSignerSeeds *signer_seeds, SysvarCache *sysvars)
+{
+    // Accounts, which entrypoint has already checked against account_schemas[Instruction_GetState]
+    SolAccountInfo *manager_account = &(params->ka[0]);
+    SolAccountInfo *vote_account = &(params->ka[1]);
+
+    if (params->data_len != 1) {
+        return Error_InvalidDataSize;
+    }
+
+    const Clock *clock = get_clock(sysvars);
+    if (!clock) {
+        return Error_FailedToGetClock;
+    }
+
+    // This is the vote account manager state
+    const VoteAccountManagerState *manager_account_state = get_manager_state(manager_account, sysvars);
+
+    // The return data is assembled here, with room for every optional section of the manager account
+    uint8_t buffer[sizeof(GetStateReturnData) + (MANAGER_STATE_COMMISSION_SCHEDULE_END - MANAGER_STATE_SIZE)];
+    GetStateReturnData *return_data = (GetStateReturnData *) buffer;
+
+    return_data->state = *manager_account_state;
+    return_data->epoch = clock->epoch;
+    return_data->vote_account_lamports = *(vote_account->lamports);
+    return_data->withdrawable_lamports = get_vote_account_withdrawable_lamports(sysvars, vote_account);
+
+    // As in SetCommission, the vote account's commission is used if the vote account version is known
+    VoteStateFields vote_state;
+    if (parse_vote_state(vote_account, &vote_state)) {
+        return_data->commission = vote_state.commission;
+    }
+    else {
+        return_data->commission = manager_account_state->current_commission;
+    }
+
+    return_data->max_allowed_commission = compute_max_allowed_commission(manager_account_state,
+                                                                         return_data->commission, clock->epoch);
+
+    uint64_t return_data_len = sizeof(GetStateReturnData);
+
+    // A legacy manager account has no optional sections; any other manager account that is larger than the state has
+    // at least a revenue split
+    if (manager_account->data_len >= MANAGER_STATE_REVENUE_SPLIT_END) {
+        uint64_t data_len = manager_account->data_len;
+        if (data_len > MANAGER_STATE_COMMISSION_SCHEDULE_END) {
+            data_len = MANAGER_STATE_COMMISSION_SCHEDULE_END;
+        }
+
+        sol_memcpy(&(buffer[return_data_len]), &(manager_account->data[MANAGER_STATE_SIZE]),
+                   data_len - MANAGER_STATE_SIZE);
+        return_data_len += data_len - MANAGER_STATE_SIZE;
+    }
+
+    sol_set_return_data(buffer, return_data_len);
+
+    return 0;
 }
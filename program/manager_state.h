@@ -0,0 +1,76 @@
+#pragma once
+
+// Layout of the data stored in a Vote Account Manager state account.  These offsets are the single definition of the
+// layout: program/entrypoint.c checks its VoteAccountManagerState structure against them at compile time, and
+// scripts/vamp reads them from this file to decode manager accounts.  Each definition must therefore remain on a
+// single line of the form "#define MANAGER_STATE_<NAME> <decimal number>".
+//
+// All multi-byte values are little endian and the layout has no padding.  The first byte is a version number, so
+// that any future change to the layout can be recognized by both the program and clients.
+
+// Version of the current layout
+#define MANAGER_STATE_VERSION 1
+
+// Offsets of the fields of the current layout
+#define MANAGER_STATE_VERSION_OFFSET 0
+#define MANAGER_STATE_BUMP_SEED_OFFSET 1
+#define MANAGER_STATE_WITHDRAW_AUTHORITY_OFFSET 2
+#define MANAGER_STATE_ADMINISTRATOR_OFFSET 34
+#define MANAGER_STATE_OPERATIONAL_AUTHORITY_OFFSET 66
+#define MANAGER_STATE_REWARDS_AUTHORITY_OFFSET 98
+#define MANAGER_STATE_USE_COMMISSION_CAPS_OFFSET 130
+#define MANAGER_STATE_MAX_COMMISSION_OFFSET 131
+#define MANAGER_STATE_MAX_COMMISSION_INCREASE_PER_EPOCH_OFFSET 132
+#define MANAGER_STATE_COMMISSION_CHANGE_EPOCH_ORIGINAL_COMMISSION_OFFSET 133
+#define MANAGER_STATE_CURRENT_COMMISSION_OFFSET 134
+#define MANAGER_STATE_COMMISSION_CHANGE_EPOCH_OFFSET 135
+#define MANAGER_STATE_LEAVE_EPOCH_OFFSET 143
+
+// Size of the current layout
+#define MANAGER_STATE_SIZE 151
+
+// A manager account may hold optional fields after the current layout.  An optional field is present only if the
+// account data is long enough to include all of it; the program grows the account to include it the first time that
+// it is set.  Every optional field ends beyond MANAGER_STATE_V0_SIZE, so that legacy accounts never appear to have one.
+
+// The revenue split: a u8 count of recipients, followed by room for MANAGER_STATE_REVENUE_SPLIT_MAX_RECIPIENTS
+// entries, each a recipient pubkey followed by a u16 share in basis points.  Only the first count entries are in use.
+#define MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET 151
+#define MANAGER_STATE_REVENUE_SPLIT_RECIPIENTS_OFFSET 152
+#define MANAGER_STATE_REVENUE_SPLIT_RECIPIENT_SIZE 34
+#define MANAGER_STATE_REVENUE_SPLIT_MAX_RECIPIENTS 8
+#define MANAGER_STATE_REVENUE_SPLIT_END 424
+
+// The sweep: a recipient pubkey, followed by a u64 minimum number of lamports.  Anyone may withdraw all available
+// lamports of the vote account to the recipient once at least the minimum are available.  A recipient of all zeroes
+// means that sweeping is disabled.
+#define MANAGER_STATE_SWEEP_RECIPIENT_OFFSET 424
+#define MANAGER_STATE_SWEEP_MINIMUM_LAMPORTS_OFFSET 456
+#define MANAGER_STATE_SWEEP_END 464
+
+// The commission schedule: a u8 count of steps, a u8 index of the next step to be applied, and room for
+// MANAGER_STATE_COMMISSION_SCHEDULE_MAX_STEPS steps, each a u64 epoch followed by the u8 commission to be set in or
+// after that epoch.  Only the first count steps are in use.
+#define MANAGER_STATE_COMMISSION_SCHEDULE_COUNT_OFFSET 464
+#define MANAGER_STATE_COMMISSION_SCHEDULE_NEXT_STEP_OFFSET 465
+#define MANAGER_STATE_COMMISSION_SCHEDULE_STEPS_OFFSET 466
+#define MANAGER_STATE_COMMISSION_SCHEDULE_STEP_SIZE 9
+#define MANAGER_STATE_COMMISSION_SCHEDULE_MAX_STEPS 8
+#define MANAGER_STATE_COMMISSION_SCHEDULE_END 538
+
+// Manager accounts created before the layout was versioned hold a naturally aligned structure with no version byte,
+// and are recognized by their size.  The program converts such an account to the current layout the first time that
+// it is passed to an instruction as writable.
+#define MANAGER_STATE_V0_SIZE 168
+#define MANAGER_STATE_V0_WITHDRAW_AUTHORITY_OFFSET 0
+#define MANAGER_STATE_V0_ADMINISTRATOR_OFFSET 32
+#define MANAGER_STATE_V0_OPERATIONAL_AUTHORITY_OFFSET 64
+#define MANAGER_STATE_V0_REWARDS_AUTHORITY_OFFSET 96
+#define MANAGER_STATE_V0_USE_COMMISSION_CAPS_OFFSET 128
+#define MANAGER_STATE_V0_MAX_COMMISSION_OFFSET 129
+#define MANAGER_STATE_V0_MAX_COMMISSION_INCREASE_PER_EPOCH_OFFSET 130
+#define MANAGER_STATE_V0_COMMISSION_CHANGE_EPOCH_OFFSET 136
+#define MANAGER_STATE_V0_COMMISSION_CHANGE_EPOCH_ORIGINAL_COMMISSION_OFFSET 144
+#define MANAGER_STATE_V0_LEAVE_EPOCH_OFFSET 152
+#define MANAGER_STATE_V0_CURRENT_COMMISSION_OFFSET 160
+#define MANAGER_STATE_V0_BUMP_SEED_OFFSET 161
@@ -0,0 +1,327 @@
+#!/bin/bash
+
+set -e
+
+# Usage: bench.sh
+#
+# Measures the compute units consumed by the Vote Account Manager program for each of its instructions, running
+# against a local solana-test-validator.  The results are written as tab separated "name compute_units" lines to
+# $BENCH_RESULTS (default: $SOURCE/bench_results.tsv).
+#
+# Each result is compared against the baseline in $SOURCE/test/bench_baseline.tsv, and if any instruction consumes
+# more compute units than its baseline, or has no baseline at all, the benchmark fails.  If BENCH_UPDATE_BASELINE is
+# set, the baseline is replaced with the results instead.
+#
+# If VAMP_PROFILE=1, the program is built with compute unit probes (see build_program.sh), and the per-stage
+# breakdown of each instruction reported by scripts/vamp-profile is written to $BENCH_PROFILE (default:
+# $SOURCE/bench_profile.txt).  The probes themselves consume compute units, so no comparison against the baseline is
+# made.
+
+if [ -z "$SOURCE" ]; then
+    echo "The SOURCE variable must be set to the root directory of the Vote Account Manager source"
+    exit 1
+fi
+
+BENCH_BASELINE=$SOURCE/test/bench_baseline.tsv
+
+if [ -z "$BENCH_RESULTS" ]; then
+    BENCH_RESULTS=$SOURCE/bench_results.tsv
+fi
+
+if [ -z "$BENCH_PROFILE" ]; then
+    BENCH_PROFILE=$SOURCE/bench_profile.txt
+fi
+
+# Without any baseline every instruction would fail, so say so before spending minutes on the measurements
+if [ -z "$BENCH_UPDATE_BASELINE" -a "$VAMP_PROFILE" != "1" ] && ! grep -q -v '^#' $BENCH_BASELINE 2>/dev/null; then
+    echo "FAIL: $BENCH_BASELINE has no measurements; record them with: make bench-baseline"
+    exit 1
+fi
+
+
+function make_funded_keypair ()
+{
+    local KEY_FILE=$1
+    local SOL=$2
+
+    echo "Creating keypair @ $KEY_FILE with $SOL SOL"
+
+    solana-keygen new -o $KEY_FILE --no-bip39-passphrase >/dev/null 2>/dev/null
+
+    if [ 0$SOL -gt 0 ]; then
+        solana -u l airdrop -k $KEY_FILE $SOL --commitment finalized >/dev/null 2>/dev/null
+    fi
+}
+
+
+# Given the output of a transaction submit, waits for the transaction to land and prints the compute units consumed
+# by the Vote Account Manager program in the transaction
+function compute_units ()
+{
+    local OUTPUT="$@"
+
+    if [[ "$OUTPUT" != Transaction\ signature:\ * ]]; then
+        return 1
+    fi
+
+    local SIGNATURE=`echo "$OUTPUT" | cut -d ' ' -f 3`
+
+    # Try for at most 10 seconds
+    for i in `seq 1 10`; do
+        local JSON=`curl -s http://localhost:8899 -X POST -H "Content-Type: application/json" -d "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"getTransaction\",\"params\":[\"$SIGNATURE\",{\"encoding\":\"json\",\"commitment\":\"confirmed\"}]}"`
+        if [ -n "$JSON" -a "`echo "$JSON" | jq .result`" != "null" ]; then
+            if [ "`echo "$JSON" | jq .result.meta.err`" != "null" ]; then
+                echo "$JSON" >&2
+                return 1
+            fi
+            # The log line for the top level invocation of the program is the last one that reports its consumption
+            echo "$JSON" | jq -r '.result.meta.logMessages[]'                                                         \
+                | grep "^Program $SELF_PROGRAM_PUBKEY consumed "                                                      \
+                | tail -1                                                                                             \
+                | cut -d ' ' -f 4
+            return 0
+        fi
+        sleep 1
+    done
+
+    return 1
+}
+
+
+# Records the compute units consumed by the transaction whose submit output is given
+function measure ()
+{
+    local NAME=$1
+    shift
+
+    local CU
+    if ! CU=`compute_units "$@"` || [ -z "$CU" ]; then
+        echo "FAIL: $NAME did not succeed:"
+        echo "$@"
+        exit 1
+    fi
+
+    echo "$NAME $CU"
+    echo -e "$NAME\t$CU" >> $BENCH_RESULTS
+
+    if [ "$VAMP_PROFILE" = "1" ]; then
+        echo "$NAME" >> $BENCH_PROFILE
+        $SOURCE/scripts/vamp-profile -u l `echo "$@" | cut -d ' ' -f 3` >> $BENCH_PROFILE
+        echo >> $BENCH_PROFILE
+    fi
+}
+
+
+# Set up
+export LEDGER=`mktemp -d`
+
+echo "Starting test validator @ $LEDGER"
+solana-test-validator --ledger $LEDGER --ticks-per-slot 16 --slots-per-epoch 400 >/dev/null 2>/dev/null &
+
+echo "Waiting 10 seconds for it to settle"
+sleep 10
+
+make_funded_keypair $LEDGER/program.json 0
+make_funded_keypair $LEDGER/withdrawer.json 100000
+make_funded_keypair $LEDGER/withdrawer2.json 100000
+make_funded_keypair $LEDGER/admin.json 100000
+make_funded_keypair $LEDGER/operations_authority.json 100000
+make_funded_keypair $LEDGER/rewards_authority.json 100000
+make_funded_keypair $LEDGER/vote_authority.json 0
+make_funded_keypair $LEDGER/user.json 100
+make_funded_keypair $LEDGER/validator_identity.json 0
+make_funded_keypair $LEDGER/validator_identity2.json 0
+make_funded_keypair $LEDGER/validator_identity3.json 0
+make_funded_keypair $LEDGER/vote_account.json 0
+make_funded_keypair $LEDGER/vote_account2.json 0
+
+echo "Creating vote accounts"
+solana -u l create-vote-account --fee-payer $LEDGER/withdrawer.json $LEDGER/vote_account.json                         \
+       $LEDGER/validator_identity.json $LEDGER/withdrawer.json >/dev/null 2>/dev/null
+solana -u l create-vote-account --fee-payer $LEDGER/withdrawer2.json $LEDGER/vote_account2.json                       \
+       $LEDGER/validator_identity2.json $LEDGER/withdrawer2.json --commitment=finalized >/dev/null 2>/dev/null
+solana -u l vote-update-commission -k $LEDGER/withdrawer.json $LEDGER/vote_account.json 0                             \
+       $LEDGER/withdrawer.json --commitment finalized >/dev/null 2>/dev/null
+
+echo "Making build script"
+$SOURCE/make_build_program.sh $LEDGER/program.json > $LEDGER/build_program.sh
+chmod +x $LEDGER/build_program.sh
+echo "Building program"
+(cd $LEDGER;                                                                                                          \
+ SDK_ROOT=~/.local/share/solana/install/active_release/bin/sdk SOURCE_ROOT=$SOURCE ./build_program.sh)
+if [ "$VAMP_PROFILE" = "1" ]; then
+    mv $LEDGER/program-profile.so $LEDGER/program.so
+fi
+
+echo "Deploying program"
+sleep 1
+solana -k $LEDGER/withdrawer.json -u l program deploy --program-id $LEDGER/program.json $LEDGER/program.so            \
+       --commitment finalized >/dev/null 2>/dev/null
+
+export SELF_PROGRAM_PUBKEY=`solxact pubkey $LEDGER/program.json`
+
+VAMP="$SOURCE/scripts/vamp -u l"
+
+rm -f $BENCH_RESULTS $BENCH_PROFILE
+
+
+# Measure every instruction.  Vote account 1 enforces commission caps and is used for everything except Leave; vote
+# account 2 does not enforce commission caps and is used to Enter and Leave, and as the second vote account of the
+# Fleet instructions.
+measure enter_commission_caps                                                                                         \
+`$VAMP enter $LEDGER/withdrawer.json $LEDGER/vote_account.json $LEDGER/admin.json 50 100 2>&1`
+
+measure enter                                                                                                         \
+`$VAMP enter $LEDGER/withdrawer2.json $LEDGER/vote_account2.json $LEDGER/admin.json 2>&1`
+
+measure set_administrator                                                                                             \
+`$VAMP set-administrator $LEDGER/withdrawer.json $LEDGER/vote_account.json $LEDGER/admin.json 2>&1`
+
+measure set_operational_authority                                                                                     \
+`$VAMP set-operational-authority $LEDGER/admin.json $LEDGER/vote_account.json $LEDGER/operations_authority.json 2>&1`
+
+measure set_rewards_authority                                                                                         \
+`$VAMP set-rewards-authority $LEDGER/admin.json $LEDGER/vote_account.json $LEDGER/rewards_authority.json 2>&1`
+
+measure set_vote_authority                                                                                            \
+`$VAMP set-vote-authority $LEDGER/operations_authority.json $LEDGER/vote_account.json                                 \
+       $LEDGER/vote_authority.json 2>&1`
+
+measure set_validator_identity                                                                                        \
+`$VAMP set-validator-identity $LEDGER/operations_authority.json $LEDGER/vote_account.json                             \
+       $LEDGER/validator_identity3.json 2>&1`
+
+echo "Sending 5 SOL to vote account to simulate rewards"
+solana -u l transfer -k $LEDGER/admin.json $LEDGER/vote_account.json 5 --commitment=finalized >/dev/null 2>/dev/null
+
+measure withdraw_amount                                                                                               \
+`$VAMP withdraw $LEDGER/rewards_authority.json $LEDGER/vote_account.json $LEDGER/user.json 1 2>&1`
+
+measure withdraw_all                                                                                                  \
+`$VAMP withdraw $LEDGER/rewards_authority.json $LEDGER/vote_account.json $LEDGER/user.json 0 2>&1`
+
+# The first commission change in an epoch records the epoch and original commission; subsequent changes in the same
+# epoch do not
+measure set_commission_new_epoch                                                                                      \
+`$VAMP set-commission $LEDGER/rewards_authority.json $LEDGER/vote_account.json 1 2>&1`
+
+measure set_commission_same_epoch                                                                                     \
+`$VAMP set-commission $LEDGER/rewards_authority.json $LEDGER/vote_account.json 2 2>&1`
+
+echo "Setting rewards authority of vote account 2 and sending 1 SOL to each vote account for the Fleet instructions"
+$VAMP set-rewards-authority $LEDGER/admin.json $LEDGER/vote_account2.json $LEDGER/rewards_authority.json >/dev/null 2>&1
+solana -u l transfer -k $LEDGER/admin.json $LEDGER/vote_account.json 1 --commitment=finalized >/dev/null 2>/dev/null
+solana -u l transfer -k $LEDGER/admin.json $LEDGER/vote_account2.json 1 --commitment=finalized >/dev/null 2>/dev/null
+
+measure fleet_withdraw                                                                                                \
+`$VAMP fleet-withdraw $LEDGER/rewards_authority.json $LEDGER/vote_account.json $LEDGER/user.json                      \
+       $LEDGER/vote_account2.json 2>&1`
+
+measure fleet_set_commission                                                                                          \
+`$VAMP fleet-set-commission $LEDGER/rewards_authority.json $LEDGER/vote_account.json 3 $LEDGER/vote_account2.json 2>&1`
+
+# vamp has no command that issues a Batch instruction, so it is built directly: SetOperationalAuthority and
+# SetRewardsAuthority, each to its current value
+MANAGER_ACCOUNT_PUBKEY=`solxact pda $SELF_PROGRAM_PUBKEY [ pubkey $LEDGER/vote_account.json ] | cut -d '.' -f 1`
+measure batch                                                                                                         \
+`echo "encoding c                                                                                                     \
+       fee_payer $LEDGER/admin.json                                                                                   \
+       program $SELF_PROGRAM_PUBKEY                                                                                   \
+       account $MANAGER_ACCOUNT_PUBKEY w                                                                              \
+       account $LEDGER/vote_account.json w                                                                            \
+       account $LEDGER/admin.json s                                                                                   \
+       u8 10                                                                                                          \
+       u8 2                                                                                                           \
+       u8 3 u8 33 u8 0 u8 1 u8 2                                                                                      \
+       u8 4                                                                                                           \
+       pubkey $LEDGER/operations_authority.json                                                                       \
+       u8 3 u8 33 u8 0 u8 1 u8 2                                                                                      \
+       u8 5                                                                                                           \
+       pubkey $LEDGER/rewards_authority.json"                                                                         \
+    | solxact encode | solxact hash l | solxact sign $LEDGER/admin.json | solxact submit l 2>&1`
+
+measure set_revenue_split                                                                                             \
+`$VAMP set-revenue-split $LEDGER/admin.json $LEDGER/vote_account.json $LEDGER/user.json 2500 2>&1`
+
+measure set_sweep                                                                                                     \
+`$VAMP set-sweep $LEDGER/rewards_authority.json $LEDGER/vote_account.json $LEDGER/user.json 1 2>&1`
+
+echo "Sending 2 SOL to vote account to simulate rewards"
+solana -u l transfer -k $LEDGER/admin.json $LEDGER/vote_account.json 2 --commitment=finalized >/dev/null 2>/dev/null
+
+measure sweep                                                                                                         \
+`$VAMP sweep $LEDGER/operations_authority.json $LEDGER/vote_account.json 2>&1`
+
+# A schedule step in the current epoch can be applied immediately; if the epoch has ended by then, it is applied late
+CURRENT_EPOCH=`solana -u l epoch-info | grep ^Epoch: | cut -d ' ' -f 2`
+measure set_commission_schedule                                                                                       \
+`$VAMP set-commission-schedule $LEDGER/rewards_authority.json $LEDGER/vote_account.json $CURRENT_EPOCH 4 2>&1`
+
+measure apply_commission_schedule                                                                                     \
+`$VAMP apply-commission-schedule $LEDGER/user.json $LEDGER/vote_account.json 2>&1`
+
+$VAMP set-commission-schedule $LEDGER/rewards_authority.json $LEDGER/vote_account.json >/dev/null 2>&1
+
+# vamp has no command that issues a GetState instruction, so it is built directly
+measure get_state                                                                                                     \
+`echo "encoding c                                                                                                     \
+       fee_payer $LEDGER/user.json                                                                                    \
+       program $SELF_PROGRAM_PUBKEY                                                                                   \
+       account $MANAGER_ACCOUNT_PUBKEY                                                                                \
+       account $LEDGER/vote_account.json                                                                              \
+       u8 18"                                                                                                         \
+    | solxact encode | solxact hash l | solxact sign $LEDGER/user.json | solxact submit l 2>&1`
+
+CURRENT_EPOCH=`solana -u l epoch-info | grep ^Epoch: | cut -d ' ' -f 2`
+measure set_leave_epoch                                                                                               \
+`$VAMP set-leave-epoch $LEDGER/withdrawer.json $LEDGER/vote_account.json $((CURRENT_EPOCH+10)) 2>&1`
+
+measure leave                                                                                                         \
+`$VAMP leave $LEDGER/withdrawer2.json $LEDGER/vote_account2.json 2>&1`
+
+
+# Tear down
+echo "Stopping test validator @ $LEDGER"
+
+solana-validator --ledger $LEDGER exit --force >/dev/null 2>/dev/null
+
+while ps auxww | grep solana-test-ledger | grep -v grep; do
+    sleep 1
+done
+
+rm -rf $LEDGER
+
+
+# Compare against, or update, the baseline
+if [ "$VAMP_PROFILE" = "1" ]; then
+    echo "Wrote per-stage profile to $BENCH_PROFILE"
+    exit 0
+fi
+
+if [ -n "$BENCH_UPDATE_BASELINE" ]; then
+    (echo "# Baseline compute units consumed by each instruction, as measured by test/bench.sh; tab separated."
+     echo "# Regenerate with: make bench-baseline"
+     cat $BENCH_RESULTS) > $BENCH_BASELINE
+    echo "Updated baseline $BENCH_BASELINE"
+    exit 0
+fi
+
+REGRESSED=
+while read NAME CU; do
+    BASELINE_CU=`grep "^$NAME	" $BENCH_BASELINE 2>/dev/null | cut -f 2`
+    if [ -z "$BASELINE_CU" ]; then
+        echo "FAIL: $NAME: $CU compute units, no baseline"
+        REGRESSED=1
+    elif [ $CU -gt $BASELINE_CU ]; then
+        echo "FAIL: $NAME: $CU compute units, baseline is $BASELINE_CU"
+        REGRESSED=1
+    else
+        echo "+ $NAME: $CU compute units, baseline is $BASELINE_CU"
+    fi
+done < $BENCH_RESULTS
+
+if [ -n "$REGRESSED" ]; then
+    exit 1
+fi
+
+echo "No compute unit regressions"
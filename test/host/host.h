@@ -0,0 +1,155 @@
+#pragma once
+
+// Host test harness for program/entrypoint.c.  Accounts live in a simulated "bank" of HostAccount values; each
+// instruction is serialized exactly as the Solana runtime would serialize it, passed to entrypoint(), and if the
+// instruction succeeds, the resulting account state is written back to the bank.  Syscalls are provided by
+// syscalls.c, which emulates just enough of the system and vote programs to exercise every instruction.
+
+#include "solana_sdk.h"
+
+
+// Largest account data that the bank can hold; this is big enough for a vote account
+#define HOST_MAX_ACCOUNT_DATA 4096
+
+// Size of a vote account
+#define HOST_VOTE_ACCOUNT_SIZE 3762
+
+// Offsets of fields within vote account data
+#define HOST_VOTE_VERSION_OFFSET 0
+#define HOST_VOTE_NODE_PUBKEY_OFFSET 4
+#define HOST_VOTE_AUTHORIZED_WITHDRAWER_OFFSET 36
+#define HOST_VOTE_COMMISSION_OFFSET 68
+
+// Error returned by the emulated runtime when a cross-program invocation is not valid
+#define HOST_ERROR_INVOKE 0x100000000ul
+
+
+// An account in the bank
+typedef struct
+{
+    SolPubkey key;
+
+    SolPubkey owner;
+
+    uint64_t lamports;
+
+    uint64_t data_len;
+
+    uint8_t data[HOST_MAX_ACCOUNT_DATA];
+
+    bool executable;
+
+} HostAccount;
+
+
+// Reference to a bank account from an instruction, with the permissions given to it by the transaction
+typedef struct
+{
+    HostAccount *account;
+
+    bool is_writable;
+
+    bool is_signer;
+
+} HostAccountRef;
+
+
+// State of the emulated runtime.  Tests may set any of the sysvar values at any time, for example to jump to any
+// epoch instantly.  The counters record how many times each syscall was made.
+typedef struct
+{
+    // Values returned by sol_get_clock_sysvar
+    uint64_t slot;
+
+    int64_t epoch_start_timestamp;
+
+    uint64_t epoch;
+
+    uint64_t leader_schedule_epoch;
+
+    int64_t unix_timestamp;
+
+    // If true, sol_get_clock_sysvar fails
+    bool clock_fails;
+
+    // Values returned by sol_get_rent_sysvar
+    uint64_t lamports_per_byte_year;
+
+    double exemption_threshold;
+
+    uint8_t burn_percent;
+
+    // The program id that the program is executing as; used to verify sol_invoke_signed signer seeds
+    SolPubkey program_id;
+
+    // The most recent vote authority set via the vote program Authorize instruction
+    SolPubkey authorized_voter;
+
+    // The most recent return data set by sol_set_return_data
+    uint8_t return_data[1024];
+
+    uint64_t return_data_len;
+
+    // The fields of the most recent sol_log_data call
+    uint8_t log_data[4][512];
+
+    uint64_t log_data_len[4];
+
+    uint64_t log_data_fields_len;
+
+    // If true, sol_log_ and sol_log_data print to stdout
+    bool print_logs;
+
+    // Syscall counters
+    uint64_t clock_sysvar_count;
+
+    uint64_t rent_sysvar_count;
+
+    uint64_t find_program_address_count;
+
+    uint64_t create_program_address_count;
+
+    uint64_t invoke_count;
+
+    uint64_t log_data_count;
+
+} HostRuntime;
+
+
+extern HostRuntime host_runtime;
+
+
+// The program entrypoint, from program/entrypoint.c
+extern uint64_t entrypoint(const uint8_t *input);
+
+
+// Resets the runtime to its defaults: epoch 100, rent of 3480 lamports per byte year with a 2 year exemption
+// threshold, and all counters zeroed
+extern void host_reset(void);
+
+// Fills in a pubkey deterministically from a number, so that tests can make distinct pubkeys easily
+extern void host_make_pubkey(SolPubkey *pubkey, uint64_t n);
+
+// Initializes an account in the bank
+extern void host_make_account(HostAccount *account, const SolPubkey *key, const SolPubkey *owner, uint64_t lamports,
+                              uint64_t data_len);
+
+// Initializes a vote account in the bank with the given withdraw authority and commission
+extern void host_make_vote_account(HostAccount *account, const SolPubkey *key, const SolPubkey *authorized_withdrawer,
+                                   uint8_t commission, uint64_t lamports);
+
+// Returns the manager account address and bump seed that the emulated runtime derives for a vote account
+extern void host_manager_address(const SolPubkey *vote_account_key, SolPubkey *manager_key, uint8_t *bump_seed);
+
+// Serializes an instruction into a newly allocated input buffer, exactly as the runtime would; the size of the
+// buffer is returned in *size
+extern uint8_t *host_serialize(const HostAccountRef *accounts, int account_count, const void *data,
+                               uint64_t data_len, uint64_t *size);
+
+// Writes account state back from an input buffer to the bank
+extern void host_write_back(const uint8_t *input, const HostAccountRef *accounts, int account_count);
+
+// Serializes and executes an instruction; if it succeeds, writes the resulting account state back to the bank.
+// Returns the result of entrypoint().
+extern uint64_t host_execute(const HostAccountRef *accounts, int account_count, const void *data,
+                             uint64_t data_len);
@@ -0,0 +1,230 @@
+#pragma once
+
+// Host stand-in for the Solana SDK's solana_sdk.h.  This declares only the types and syscalls that
+// program/entrypoint.c uses, with the same names and signatures as the Solana SDK, so that entrypoint.c can be
+// compiled unmodified for the host.  The syscalls are implemented in syscalls.c.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Size of a public key in bytes
+#define SIZE_PUBKEY 32
+
+// Maximum number of bytes a program may add to an account during a single instruction
+#define MAX_PERMITTED_DATA_INCREASE (1024 * 10)
+
+// The program heap, which on the host is a static buffer in syscalls.c rather than a fixed virtual address
+extern uint8_t host_heap[];
+#define HEAP_START_ADDRESS ((uint64_t) host_heap)
+#define HEAP_LENGTH ((uint64_t) (32 * 1024))
+
+
+// Public key
+typedef struct
+{
+    uint8_t x[SIZE_PUBKEY];
+
+} SolPubkey;
+
+
+// Keyed account, as deserialized from program input
+typedef struct
+{
+    SolPubkey *key;
+
+    uint64_t *lamports;
+
+    uint64_t data_len;
+
+    uint8_t *data;
+
+    SolPubkey *owner;
+
+    uint64_t rent_epoch;
+
+    bool is_signer;
+
+    bool is_writable;
+
+    bool executable;
+
+} SolAccountInfo;
+
+
+// Structure that the program's entrypoint input data is deserialized into
+typedef struct
+{
+    SolAccountInfo *ka;
+
+    uint64_t ka_num;
+
+    const uint8_t *data;
+
+    uint64_t data_len;
+
+    const SolPubkey *program_id;
+
+} SolParameters;
+
+
+// Seed used to create a program address or passed to sol_invoke_signed
+typedef struct
+{
+    const uint8_t *addr;
+
+    uint64_t len;
+
+} SolSignerSeed;
+
+
+// Seeds used by a signer to create a program address or passed to sol_invoke_signed
+typedef struct
+{
+    const SolSignerSeed *addr;
+
+    uint64_t len;
+
+} SolSignerSeeds;
+
+
+// Account meta, as used in cross-program invocations
+typedef struct
+{
+    SolPubkey *pubkey;
+
+    bool is_writable;
+
+    bool is_signer;
+
+} SolAccountMeta;
+
+
+// Instruction, as used in cross-program invocations
+typedef struct
+{
+    SolPubkey *program_id;
+
+    SolAccountMeta *accounts;
+
+    uint64_t account_len;
+
+    uint8_t *data;
+
+    uint64_t data_len;
+
+} SolInstruction;
+
+
+// Byte array pointer and length, as used by sol_log_data
+typedef struct
+{
+    const uint8_t *addr;
+
+    uint64_t len;
+
+} SolBytes;
+
+
+// Syscalls, implemented by syscalls.c
+
+extern void sol_memcpy_(void *dst, const void *src, uint64_t n);
+
+extern int sol_memcmp_(const void *s1, const void *s2, uint64_t n, int *result);
+
+extern void sol_memset_(void *s, uint8_t c, uint64_t n);
+
+extern void sol_log_(const char *message, uint64_t len);
+
+extern void sol_log_64_(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4, uint64_t arg5);
+
+extern void sol_log_compute_units_(void);
+
+extern void sol_log_data(SolBytes *fields, uint64_t fields_len);
+
+extern void sol_set_return_data(const uint8_t *bytes, uint64_t bytes_len);
+
+extern uint64_t sol_get_return_data(uint8_t *bytes, uint64_t bytes_len, SolPubkey *program_id);
+
+extern uint64_t sol_create_program_address(const SolSignerSeed *seeds, int seeds_len, const SolPubkey *program_id,
+                                           SolPubkey *program_address);
+
+extern uint64_t sol_try_find_program_address(const SolSignerSeed *seeds, int seeds_len, const SolPubkey *program_id,
+                                             SolPubkey *program_address, uint8_t *bump_seed);
+
+extern uint64_t sol_invoke_signed_c(const SolInstruction *instruction, const SolAccountInfo *account_infos,
+                                    int account_infos_len, const SolSignerSeeds *signers_seeds,
+                                    int signers_seeds_len);
+
+
+// Inline helpers with the same definitions as the Solana SDK
+
+static inline void sol_memcpy(void *dst, const void *src, int len)
+{
+    sol_memcpy_(dst, src, len);
+}
+
+
+static inline int sol_memcmp(const void *s1, const void *s2, int n)
+{
+    int result;
+
+    sol_memcmp_(s1, s2, n, &result);
+
+    return result;
+}
+
+
+static inline void sol_memset(void *b, int c, size_t len)
+{
+    sol_memset_(b, c, len);
+}
+
+
+static inline size_t sol_strlen(const char *s)
+{
+    size_t len = 0;
+
+    while (*s++) {
+        len++;
+    }
+
+    return len;
+}
+
+
+#define sol_log(message) sol_log_(message, sol_strlen(message))
+
+#define sol_log_64 sol_log_64_
+
+#define sol_log_compute_units() sol_log_compute_units_()
+
+
+static inline bool SolPubkey_same(const SolPubkey *one, const SolPubkey *two)
+{
+    for (int i = 0; i < (int) sizeof(*one); i++) {
+        if (one->x[i] != two->x[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static inline uint64_t sol_invoke_signed(const SolInstruction *instruction, const SolAccountInfo *account_infos,
+                                         int account_infos_len, const SolSignerSeeds *signers_seeds,
+                                         int signers_seeds_len)
+{
+    return sol_invoke_signed_c(instruction, account_infos, account_infos_len, signers_seeds, signers_seeds_len);
+}
+
+
+static inline uint64_t sol_invoke(const SolInstruction *instruction, const SolAccountInfo *account_infos,
+                                  int account_infos_len)
+{
+    const SolSignerSeeds signers_seeds[] = { { 0, 0 } };
+
+    return sol_invoke_signed(instruction, account_infos, account_infos_len, signers_seeds, 0);
+}
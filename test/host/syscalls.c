@@ -0,0 +1,693 @@
+
+// Host implementations of the Solana syscalls used by program/entrypoint.c.  Sysvars are taken from host_runtime so
+// that tests control them directly.  Program derived addresses are computed with a fast non-cryptographic hash
+// rather than SHA-256, with "on curve" emulated by one bit of the hash, so that bump seed searches still happen.
+// Cross-program invocations verify account permissions and signer seeds, and then emulate the effects of the system
+// and vote program instructions that the program issues.
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+HostRuntime host_runtime;
+
+uint8_t host_heap[32 * 1024] __attribute__((__aligned__(16)));
+
+
+static const SolPubkey system_program_pubkey = { SYSTEM_PROGRAM_PUBKEY_ARRAY };
+
+static const SolPubkey vote_program_pubkey = { VOTE_PROGRAM_PUBKEY_ARRAY };
+
+static const SolPubkey self_program_pubkey = { SELF_PROGRAM_PUBKEY_ARRAY };
+
+
+// Layouts of the sysvars, as the program reads them -------------------------------------------------------------------
+
+typedef struct __attribute__((__packed__))
+{
+    uint64_t slot;
+
+    int64_t epoch_start_timestamp;
+
+    uint64_t epoch;
+
+    uint64_t leader_schedule_epoch;
+
+    int64_t unix_timestamp;
+
+} HostClock;
+
+
+// Not packed: the runtime writes the Rust Rent structure including its trailing padding, 24 bytes in total
+typedef struct
+{
+    uint64_t lamports_per_byte_year;
+
+    double exemption_threshold;
+
+    uint8_t burn_percent;
+
+} HostRent;
+
+
+// Runtime control ----------------------------------------------------------------------------------------------------
+
+void host_reset(void)
+{
+    memset(&host_runtime, 0, sizeof(host_runtime));
+
+    host_runtime.slot = 100 * 432000;
+    host_runtime.epoch = 100;
+    host_runtime.leader_schedule_epoch = 101;
+    host_runtime.lamports_per_byte_year = 3480;
+    host_runtime.exemption_threshold = 2.0;
+    host_runtime.burn_percent = 50;
+    host_runtime.program_id = self_program_pubkey;
+}
+
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ul);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ul;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBul;
+
+    return z ^ (z >> 31);
+}
+
+
+void host_make_pubkey(SolPubkey *pubkey, uint64_t n)
+{
+    uint64_t state = n;
+
+    for (int i = 0; i < 4; i++) {
+        uint64_t v = splitmix64(&state);
+        memcpy(&(pubkey->x[i * 8]), &v, 8);
+    }
+}
+
+
+void host_make_account(HostAccount *account, const SolPubkey *key, const SolPubkey *owner, uint64_t lamports,
+                       uint64_t data_len)
+{
+    memset(account, 0, sizeof(*account));
+
+    account->key = *key;
+    account->owner = *owner;
+    account->lamports = lamports;
+    account->data_len = data_len;
+}
+
+
+void host_make_vote_account(HostAccount *account, const SolPubkey *key, const SolPubkey *authorized_withdrawer,
+                            uint8_t commission, uint64_t lamports)
+{
+    host_make_account(account, key, &vote_program_pubkey, lamports, HOST_VOTE_ACCOUNT_SIZE);
+
+    // Version 1 (V1_14_11)
+    account->data[HOST_VOTE_VERSION_OFFSET] = 1;
+
+    SolPubkey node_pubkey;
+    host_make_pubkey(&node_pubkey, 0x40de);
+    memcpy(&(account->data[HOST_VOTE_NODE_PUBKEY_OFFSET]), &node_pubkey, sizeof(SolPubkey));
+
+    memcpy(&(account->data[HOST_VOTE_AUTHORIZED_WITHDRAWER_OFFSET]), authorized_withdrawer, sizeof(SolPubkey));
+
+    account->data[HOST_VOTE_COMMISSION_OFFSET] = commission;
+}
+
+
+// Program derived addresses ------------------------------------------------------------------------------------------
+
+// Computes a program address from seeds.  Returns false if the resulting address is "on the curve" and thus is not
+// a valid program address.
+static bool compute_program_address(const SolSignerSeed *seeds, int seeds_len, const SolPubkey *program_id,
+                                    SolPubkey *program_address)
+{
+    // FNV-1a over the seeds and program id
+    uint64_t hash = 0xCBF29CE484222325ul;
+
+    for (int i = 0; i < seeds_len; i++) {
+        for (uint64_t j = 0; j < seeds[i].len; j++) {
+            hash = (hash ^ seeds[i].addr[j]) * 0x100000001B3ul;
+        }
+        // Separate seeds so that seed boundaries matter
+        hash = (hash ^ 0xFF) * 0x100000001B3ul;
+    }
+
+    for (int i = 0; i < (int) sizeof(SolPubkey); i++) {
+        hash = (hash ^ program_id->x[i]) * 0x100000001B3ul;
+    }
+
+    host_make_pubkey(program_address, hash);
+
+    return (program_address->x[31] & 1) == 0;
+}
+
+
+uint64_t sol_create_program_address(const SolSignerSeed *seeds, int seeds_len, const SolPubkey *program_id,
+                                    SolPubkey *program_address)
+{
+    host_runtime.create_program_address_count++;
+
+    return compute_program_address(seeds, seeds_len, program_id, program_address) ? 0 : 1;
+}
+
+
+uint64_t sol_try_find_program_address(const SolSignerSeed *seeds, int seeds_len, const SolPubkey *program_id,
+                                      SolPubkey *program_address, uint8_t *bump_seed)
+{
+    host_runtime.find_program_address_count++;
+
+    SolSignerSeed bumped_seeds[17];
+
+    if (seeds_len > 16) {
+        return 1;
+    }
+
+    memcpy(bumped_seeds, seeds, seeds_len * sizeof(SolSignerSeed));
+
+    for (int bump = 255; bump >= 0; bump--) {
+        uint8_t b = bump;
+        bumped_seeds[seeds_len].addr = &b;
+        bumped_seeds[seeds_len].len = 1;
+        if (compute_program_address(bumped_seeds, seeds_len + 1, program_id, program_address)) {
+            *bump_seed = b;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+void host_manager_address(const SolPubkey *vote_account_key, SolPubkey *manager_key, uint8_t *bump_seed)
+{
+    SolSignerSeed seed = { (const uint8_t *) vote_account_key, sizeof(SolPubkey) };
+
+    uint64_t count = host_runtime.find_program_address_count;
+
+    (void) sol_try_find_program_address(&seed, 1, &self_program_pubkey, manager_key, bump_seed);
+
+    // Don't count this, as the program didn't do it
+    host_runtime.find_program_address_count = count;
+}
+
+
+// Sysvars ------------------------------------------------------------------------------------------------------------
+
+uint64_t sol_get_clock_sysvar(void *ret)
+{
+    host_runtime.clock_sysvar_count++;
+
+    if (host_runtime.clock_fails) {
+        return 1;
+    }
+
+    HostClock clock = { host_runtime.slot, host_runtime.epoch_start_timestamp, host_runtime.epoch,
+                        host_runtime.leader_schedule_epoch, host_runtime.unix_timestamp };
+
+    memcpy(ret, &clock, sizeof(clock));
+
+    return 0;
+}
+
+
+uint64_t sol_get_rent_sysvar(void *ret)
+{
+    host_runtime.rent_sysvar_count++;
+
+    HostRent rent = { host_runtime.lamports_per_byte_year, host_runtime.exemption_threshold,
+                      host_runtime.burn_percent };
+
+    memcpy(ret, &rent, sizeof(rent));
+
+    return 0;
+}
+
+
+// Memory, logging, and return data -----------------------------------------------------------------------------------
+
+void sol_memcpy_(void *dst, const void *src, uint64_t n)
+{
+    memmove(dst, src, n);
+}
+
+
+int sol_memcmp_(const void *s1, const void *s2, uint64_t n, int *result)
+{
+    *result = memcmp(s1, s2, n);
+
+    return 0;
+}
+
+
+void sol_memset_(void *s, uint8_t c, uint64_t n)
+{
+    memset(s, c, n);
+}
+
+
+void sol_log_(const char *message, uint64_t len)
+{
+    if (host_runtime.print_logs) {
+        printf("Program log: %.*s\n", (int) len, message);
+    }
+}
+
+
+void sol_log_64_(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4, uint64_t arg5)
+{
+    if (host_runtime.print_logs) {
+        printf("Program log: 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx\n", arg1, arg2, arg3, arg4, arg5);
+    }
+}
+
+
+void sol_log_compute_units_(void)
+{
+    if (host_runtime.print_logs) {
+        printf("Program consumption: (not measured on host)\n");
+    }
+}
+
+
+void sol_log_data(SolBytes *fields, uint64_t fields_len)
+{
+    host_runtime.log_data_count++;
+
+    if (fields_len > (sizeof(host_runtime.log_data) / sizeof(host_runtime.log_data[0]))) {
+        fields_len = (sizeof(host_runtime.log_data) / sizeof(host_runtime.log_data[0]));
+    }
+
+    for (uint64_t i = 0; i < fields_len; i++) {
+        uint64_t len = fields[i].len;
+        if (len > sizeof(host_runtime.log_data[i])) {
+            len = sizeof(host_runtime.log_data[i]);
+        }
+        memcpy(host_runtime.log_data[i], fields[i].addr, len);
+        host_runtime.log_data_len[i] = len;
+    }
+
+    host_runtime.log_data_fields_len = fields_len;
+
+    if (host_runtime.print_logs) {
+        printf("Program data:");
+        for (uint64_t i = 0; i < fields_len; i++) {
+            printf(" ");
+            for (uint64_t j = 0; j < fields[i].len; j++) {
+                printf("%02x", fields[i].addr[j]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+
+void sol_set_return_data(const uint8_t *bytes, uint64_t bytes_len)
+{
+    if (bytes_len > sizeof(host_runtime.return_data)) {
+        bytes_len = sizeof(host_runtime.return_data);
+    }
+
+    memcpy(host_runtime.return_data, bytes, bytes_len);
+
+    host_runtime.return_data_len = bytes_len;
+}
+
+
+uint64_t sol_get_return_data(uint8_t *bytes, uint64_t bytes_len, SolPubkey *program_id)
+{
+    if (bytes_len > host_runtime.return_data_len) {
+        bytes_len = host_runtime.return_data_len;
+    }
+
+    memcpy(bytes, host_runtime.return_data, bytes_len);
+
+    *program_id = host_runtime.program_id;
+
+    return host_runtime.return_data_len;
+}
+
+
+// Cross-program invocation -------------------------------------------------------------------------------------------
+
+static SolAccountInfo *find_account_info(const SolAccountInfo *account_infos, int account_infos_len,
+                                         const SolPubkey *pubkey)
+{
+    for (int i = 0; i < account_infos_len; i++) {
+        if (SolPubkey_same(account_infos[i].key, pubkey)) {
+            return (SolAccountInfo *) &(account_infos[i]);
+        }
+    }
+
+    return 0;
+}
+
+
+static bool is_pda_signer(const SolPubkey *pubkey, const SolSignerSeeds *signers_seeds, int signers_seeds_len)
+{
+    for (int i = 0; i < signers_seeds_len; i++) {
+        SolPubkey address;
+        if (compute_program_address(signers_seeds[i].addr, signers_seeds[i].len, &(host_runtime.program_id),
+                                    &address) &&
+            SolPubkey_same(&address, pubkey)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Sets the data length of an account, both in the serialized input and in the account info
+static void set_data_len(SolAccountInfo *account, uint64_t data_len)
+{
+    ((uint64_t *) (account->data))[-1] = data_len;
+
+    account->data_len = data_len;
+}
+
+
+static uint64_t invoke_system_program(const SolInstruction *instruction, SolAccountInfo **accounts)
+{
+    if (instruction->data_len < 4) {
+        return HOST_ERROR_INVOKE;
+    }
+
+    uint32_t code;
+    memcpy(&code, instruction->data, sizeof(code));
+
+    switch (code) {
+    case 0: { // CreateAccount
+        if ((instruction->account_len != 2) || (instruction->data_len != 52)) {
+            return HOST_ERROR_INVOKE;
+        }
+        uint64_t lamports, space;
+        memcpy(&lamports, &(instruction->data[4]), sizeof(lamports));
+        memcpy(&space, &(instruction->data[12]), sizeof(space));
+        if ((*(accounts[1]->lamports) > 0) || (accounts[1]->data_len > 0) ||
+            (*(accounts[0]->lamports) < lamports) || (space > MAX_PERMITTED_DATA_INCREASE)) {
+            return HOST_ERROR_INVOKE;
+        }
+        *(accounts[0]->lamports) -= lamports;
+        *(accounts[1]->lamports) += lamports;
+        set_data_len(accounts[1], space);
+        memcpy(accounts[1]->owner, &(instruction->data[20]), sizeof(SolPubkey));
+        return 0;
+    }
+
+    case 1: // Assign
+        if ((instruction->account_len != 1) || (instruction->data_len != 36) ||
+            !SolPubkey_same(accounts[0]->owner, &system_program_pubkey)) {
+            return HOST_ERROR_INVOKE;
+        }
+        memcpy(accounts[0]->owner, &(instruction->data[4]), sizeof(SolPubkey));
+        return 0;
+
+    case 2: { // Transfer
+        if ((instruction->account_len != 2) || (instruction->data_len != 12)) {
+            return HOST_ERROR_INVOKE;
+        }
+        uint64_t lamports;
+        memcpy(&lamports, &(instruction->data[4]), sizeof(lamports));
+        if (*(accounts[0]->lamports) < lamports) {
+            return HOST_ERROR_INVOKE;
+        }
+        *(accounts[0]->lamports) -= lamports;
+        *(accounts[1]->lamports) += lamports;
+        return 0;
+    }
+
+    case 8: { // Allocate
+        if ((instruction->account_len != 1) || (instruction->data_len != 12) || (accounts[0]->data_len > 0) ||
+            !SolPubkey_same(accounts[0]->owner, &system_program_pubkey)) {
+            return HOST_ERROR_INVOKE;
+        }
+        uint64_t space;
+        memcpy(&space, &(instruction->data[4]), sizeof(space));
+        if (space > MAX_PERMITTED_DATA_INCREASE) {
+            return HOST_ERROR_INVOKE;
+        }
+        set_data_len(accounts[0], space);
+        return 0;
+    }
+
+    default:
+        return HOST_ERROR_INVOKE;
+    }
+}
+
+
+// Returns true if the withdraw authority of the vote account is among the signers of the instruction
+static bool vote_withdrawer_signed(const SolInstruction *instruction, SolAccountInfo *vote_account)
+{
+    for (uint64_t i = 0; i < instruction->account_len; i++) {
+        if (instruction->accounts[i].is_signer &&
+            !memcmp(instruction->accounts[i].pubkey, &(vote_account->data[HOST_VOTE_AUTHORIZED_WITHDRAWER_OFFSET]),
+                    sizeof(SolPubkey))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+static uint64_t invoke_vote_program(const SolInstruction *instruction, SolAccountInfo **accounts)
+{
+    if ((instruction->data_len < 4) || (instruction->account_len < 2)) {
+        return HOST_ERROR_INVOKE;
+    }
+
+    SolAccountInfo *vote_account = accounts[0];
+
+    if (!SolPubkey_same(vote_account->owner, &vote_program_pubkey) ||
+        (vote_account->data_len <= HOST_VOTE_COMMISSION_OFFSET) || !vote_withdrawer_signed(instruction, vote_account)) {
+        return HOST_ERROR_INVOKE;
+    }
+
+    uint32_t code;
+    memcpy(&code, instruction->data, sizeof(code));
+
+    switch (code) {
+    case 1: { // Authorize
+        if ((instruction->account_len != 3) || (instruction->data_len != 40)) {
+            return HOST_ERROR_INVOKE;
+        }
+        uint32_t authorize;
+        memcpy(&authorize, &(instruction->data[36]), sizeof(authorize));
+        if (authorize == 0) {
+            memcpy(&(host_runtime.authorized_voter), &(instruction->data[4]), sizeof(SolPubkey));
+        }
+        else {
+            memcpy(&(vote_account->data[HOST_VOTE_AUTHORIZED_WITHDRAWER_OFFSET]), &(instruction->data[4]),
+                   sizeof(SolPubkey));
+        }
+        return 0;
+    }
+
+    case 3: { // Withdraw
+        if ((instruction->account_len != 3) || (instruction->data_len != 12)) {
+            return HOST_ERROR_INVOKE;
+        }
+        uint64_t lamports;
+        memcpy(&lamports, &(instruction->data[4]), sizeof(lamports));
+        if (*(vote_account->lamports) < lamports) {
+            return HOST_ERROR_INVOKE;
+        }
+        *(vote_account->lamports) -= lamports;
+        *(accounts[1]->lamports) += lamports;
+        return 0;
+    }
+
+    case 4: // UpdateValidatorIdentity
+        if ((instruction->account_len != 3) || !instruction->accounts[1].is_signer) {
+            return HOST_ERROR_INVOKE;
+        }
+        memcpy(&(vote_account->data[HOST_VOTE_NODE_PUBKEY_OFFSET]), accounts[1]->key, sizeof(SolPubkey));
+        return 0;
+
+    case 5: // UpdateCommission
+        if ((instruction->account_len != 2) || (instruction->data_len != 5)) {
+            return HOST_ERROR_INVOKE;
+        }
+        vote_account->data[HOST_VOTE_COMMISSION_OFFSET] = instruction->data[4];
+        return 0;
+
+    default:
+        return HOST_ERROR_INVOKE;
+    }
+}
+
+
+uint64_t sol_invoke_signed_c(const SolInstruction *instruction, const SolAccountInfo *account_infos,
+                             int account_infos_len, const SolSignerSeeds *signers_seeds, int signers_seeds_len)
+{
+    host_runtime.invoke_count++;
+
+    SolAccountInfo *accounts[16];
+
+    if (instruction->account_len > 16) {
+        return HOST_ERROR_INVOKE;
+    }
+
+    // Every account referenced by the instruction must be present, and the caller must hold the privileges that it
+    // passes along
+    for (uint64_t i = 0; i < instruction->account_len; i++) {
+        const SolAccountMeta *meta = &(instruction->accounts[i]);
+        accounts[i] = find_account_info(account_infos, account_infos_len, meta->pubkey);
+        if (!accounts[i]) {
+            return HOST_ERROR_INVOKE;
+        }
+        if (meta->is_writable && !accounts[i]->is_writable) {
+            return HOST_ERROR_INVOKE;
+        }
+        if (meta->is_signer && !accounts[i]->is_signer &&
+            !is_pda_signer(meta->pubkey, signers_seeds, signers_seeds_len)) {
+            return HOST_ERROR_INVOKE;
+        }
+    }
+
+    if (SolPubkey_same(instruction->program_id, &system_program_pubkey)) {
+        return invoke_system_program(instruction, accounts);
+    }
+    else if (SolPubkey_same(instruction->program_id, &vote_program_pubkey)) {
+        return invoke_vote_program(instruction, accounts);
+    }
+    else {
+        return HOST_ERROR_INVOKE;
+    }
+}
+
+
+// Input serialization ------------------------------------------------------------------------------------------------
+
+// Rounds a pointer up to 8 byte alignment
+static const uint8_t *align_8(const uint8_t *p)
+{
+    return (const uint8_t *) ((((uint64_t) p) + 7) & ~7ul);
+}
+
+
+// Returns the index of the first reference to the same account as accounts[index]
+static int first_reference(const HostAccountRef *accounts, int index)
+{
+    for (int i = 0; i < index; i++) {
+        if (accounts[i].account == accounts[index].account) {
+            return i;
+        }
+    }
+
+    return index;
+}
+
+
+uint8_t *host_serialize(const HostAccountRef *accounts, int account_count, const void *data, uint64_t data_len,
+                        uint64_t *size)
+{
+    uint64_t capacity = 8 + (account_count * (8 + 64 + 16 + HOST_MAX_ACCOUNT_DATA + MAX_PERMITTED_DATA_INCREASE + 16)) +
+        8 + data_len + 32;
+
+    // calloc returns 16 byte aligned memory, so aligning addresses is the same as aligning offsets
+    uint8_t *input = calloc(1, capacity);
+    uint8_t *p = input;
+
+    *((uint64_t *) p) = account_count;
+    p += 8;
+
+    for (int i = 0; i < account_count; i++) {
+        int first = first_reference(accounts, i);
+        if (first != i) {
+            *p = first;
+            p += 8;
+            continue;
+        }
+        // As in a transaction, privileges belong to the account, so are the union of those of all references to it
+        const HostAccount *account = accounts[i].account;
+        bool is_signer = false, is_writable = false;
+        for (int j = i; j < account_count; j++) {
+            if (accounts[j].account == account) {
+                is_signer |= accounts[j].is_signer;
+                is_writable |= accounts[j].is_writable;
+            }
+        }
+        *p++ = 0xFF;
+        *p++ = is_signer;
+        *p++ = is_writable;
+        *p++ = account->executable;
+        p += 4;
+        memcpy(p, &(account->key), 32);
+        p += 32;
+        memcpy(p, &(account->owner), 32);
+        p += 32;
+        *((uint64_t *) p) = account->lamports;
+        p += 8;
+        *((uint64_t *) p) = account->data_len;
+        p += 8;
+        memcpy(p, account->data, account->data_len);
+        p += account->data_len + MAX_PERMITTED_DATA_INCREASE;
+        p = (uint8_t *) align_8(p);
+        // rent_epoch
+        p += 8;
+    }
+
+    *((uint64_t *) p) = data_len;
+    p += 8;
+    memcpy(p, data, data_len);
+    p += data_len;
+    memcpy(p, &(host_runtime.program_id), 32);
+    p += 32;
+
+    *size = p - input;
+
+    return input;
+}
+
+
+void host_write_back(const uint8_t *input, const HostAccountRef *accounts, int account_count)
+{
+    const uint8_t *p = input + 8;
+
+    for (int i = 0; i < account_count; i++) {
+        if (*p != 0xFF) {
+            p += 8;
+            continue;
+        }
+        HostAccount *account = accounts[i].account;
+        p += 8 + 32;
+        memcpy(&(account->owner), p, 32);
+        p += 32;
+        account->lamports = *((const uint64_t *) p);
+        p += 8;
+        uint64_t original_data_len = account->data_len;
+        account->data_len = *((const uint64_t *) p);
+        p += 8;
+        memcpy(account->data, p, account->data_len);
+        p += original_data_len + MAX_PERMITTED_DATA_INCREASE;
+        p = align_8(p);
+        p += 8;
+    }
+}
+
+
+uint64_t host_execute(const HostAccountRef *accounts, int account_count, const void *data, uint64_t data_len)
+{
+    uint64_t size;
+
+    uint8_t *input = host_serialize(accounts, account_count, data, data_len, &size);
+
+    uint64_t ret = entrypoint(input);
+
+    if (ret == 0) {
+        host_write_back(input, accounts, account_count);
+    }
+
+    free(input);
+
+    return ret;
+}
@@ -0,0 +1,1710 @@
+
+// Host-native tests and benchmarks for the Vote Account Manager program.  entrypoint.c is included directly so that
+// the tests use the program's own instruction data and state structures.
+//
+// Usage: test_host                  -- Runs all tests
+//        test_host bench [<COUNT>]  -- Runs every instruction COUNT times (default 1000000) and reports the rate
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "entrypoint.c"
+
+// The program's memcpy is renamed on the host command line; the C library memcpy is used from here on
+#undef memcpy
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// The bank ------------------------------------------------------------------------------------------------------------
+
+static HostAccount withdrawer, admin, operational_authority, rewards_authority, user, new_validator_identity;
+static HostAccount vote_account, manager_account;
+static HostAccount system_program, vote_program, clock_sysvar;
+
+
+// Builds a bank with a vote account having commission 0, whose withdraw authority is withdrawer, and with a manager
+// account address that does not exist yet
+static void setup()
+{
+    host_reset();
+
+    SolPubkey key;
+
+    host_make_pubkey(&key, 1);
+    host_make_account(&withdrawer, &key, &(Constants.system_program_pubkey), 100000000000ul, 0);
+    host_make_pubkey(&key, 2);
+    host_make_account(&admin, &key, &(Constants.system_program_pubkey), 100000000000ul, 0);
+    host_make_pubkey(&key, 3);
+    host_make_account(&operational_authority, &key, &(Constants.system_program_pubkey), 100000000000ul, 0);
+    host_make_pubkey(&key, 4);
+    host_make_account(&rewards_authority, &key, &(Constants.system_program_pubkey), 100000000000ul, 0);
+    host_make_pubkey(&key, 5);
+    host_make_account(&user, &key, &(Constants.system_program_pubkey), 100000000000ul, 0);
+    host_make_pubkey(&key, 6);
+    host_make_account(&new_validator_identity, &key, &(Constants.system_program_pubkey), 0, 0);
+
+    host_make_pubkey(&key, 7);
+    host_make_vote_account(&vote_account, &key, &(withdrawer.key), 0, 27074400);
+
+    uint8_t bump_seed;
+    host_manager_address(&(vote_account.key), &key, &bump_seed);
+    host_make_account(&manager_account, &key, &(Constants.system_program_pubkey), 0, 0);
+
+    host_make_account(&system_program, &(Constants.system_program_pubkey), &(Constants.system_program_pubkey), 1, 0);
+    system_program.executable = true;
+    host_make_account(&vote_program, &(Constants.vote_program_pubkey), &(Constants.system_program_pubkey), 1, 0);
+    vote_program.executable = true;
+    host_make_account(&clock_sysvar, &(Constants.clock_sysvar_pubkey), &(Constants.system_program_pubkey), 1, 40);
+}
+
+
+// Account reference helpers
+#define R(a)  { &(a), false, false }
+#define W(a)  { &(a), true,  false }
+#define S(a)  { &(a), false, true  }
+#define WS(a) { &(a), true,  true  }
+
+#define EXECUTE(data, ...) execute((HostAccountRef []) { __VA_ARGS__ },                                              \
+                                   sizeof((HostAccountRef []) { __VA_ARGS__ }) / sizeof(HostAccountRef),              \
+                                   &(data), sizeof(data))
+
+static uint64_t execute(const HostAccountRef *accounts, int account_count, const void *data, uint64_t data_len)
+{
+    return host_execute(accounts, account_count, data, data_len);
+}
+
+
+// Assertions ---------------------------------------------------------------------------------------------------------
+
+static void assert_success(const char *test_name, uint64_t result)
+{
+    if (result) {
+        printf("FAIL: %s failed when success was expected: %lu\n", test_name, result);
+        exit(1);
+    }
+
+    printf("+ %s\n", test_name);
+}
+
+
+static void assert_fail(const char *test_name, uint64_t expected, uint64_t result)
+{
+    if (result != expected) {
+        printf("FAIL: %s incorrect result: expected %lu, got %lu\n", test_name, expected, result);
+        exit(1);
+    }
+
+    printf("- %s\n", test_name);
+}
+
+
+static void check(const char *test_name, bool condition, const char *message)
+{
+    if (!condition) {
+        printf("FAIL: %s: %s\n", test_name, message);
+        exit(1);
+    }
+}
+
+
+static const VoteAccountManagerState *manager_state()
+{
+    return (const VoteAccountManagerState *) manager_account.data;
+}
+
+
+// Returns the rent exempt minimum of an account of the given size, as computed by the program, without counting the
+// Rent sysvar fetch
+static uint64_t rent_exempt_minimum(uint64_t account_size)
+{
+    uint64_t rent_sysvar_count = host_runtime.rent_sysvar_count;
+
+    SysvarCache sysvars;
+    sysvars.present = 0;
+
+    uint64_t result = compute_rent_exempt_minimum(get_rent(&sysvars), account_size);
+
+    host_runtime.rent_sysvar_count = rent_sysvar_count;
+
+    return result;
+}
+
+
+static uint8_t vote_account_commission()
+{
+    return vote_account.data[HOST_VOTE_COMMISSION_OFFSET];
+}
+
+
+static bool vote_account_withdrawer_is(const HostAccount *account)
+{
+    return !memcmp(&(vote_account.data[HOST_VOTE_AUTHORIZED_WITHDRAWER_OFFSET]), &(account->key), sizeof(SolPubkey));
+}
+
+
+// Checks that the most recent event logged by the program is the event of instruction for vote_account, in the current
+// epoch, with the given lamports and old and new values
+static void check_event(const char *test_name, Instruction instruction, uint64_t lamports, const void *old_value,
+                        uint64_t old_value_len, const void *new_value, uint64_t new_value_len)
+{
+    const EventHeader *header = (const EventHeader *) host_runtime.log_data[0];
+
+    check(test_name, host_runtime.log_data_fields_len == 3, "incorrect number of event fields");
+    check(test_name, host_runtime.log_data_len[0] == sizeof(EventHeader), "incorrect event header size");
+    check(test_name, header->instruction_code == instruction, "incorrect event instruction code");
+    check(test_name, header->epoch == host_runtime.epoch, "incorrect event epoch");
+    check(test_name, SolPubkey_same(&(header->vote_account), &(vote_account.key)), "incorrect event vote account");
+    check(test_name, header->lamports == lamports, "incorrect event lamports");
+    check(test_name, (host_runtime.log_data_len[1] == old_value_len) &&
+          !memcmp(host_runtime.log_data[1], old_value, old_value_len), "incorrect event old value");
+    check(test_name, (host_runtime.log_data_len[2] == new_value_len) &&
+          !memcmp(host_runtime.log_data[2], new_value, new_value_len), "incorrect event new value");
+}
+
+
+// Returns the u64 return data of the most recent instruction, which must have returned a u64
+static uint64_t return_data_u64(const char *test_name)
+{
+    uint64_t value;
+
+    check(test_name, host_runtime.return_data_len == sizeof(value), "incorrect return data size");
+    memcpy(&value, host_runtime.return_data, sizeof(value));
+
+    return value;
+}
+
+
+// Checks that the most recent instruction returned the given CommissionReturnData
+static void check_commission_return_data(const char *test_name, uint8_t commission, uint8_t max_allowed_commission)
+{
+    const CommissionReturnData *return_data = (const CommissionReturnData *) host_runtime.return_data;
+
+    check(test_name, host_runtime.return_data_len == sizeof(CommissionReturnData), "incorrect return data size");
+    check(test_name, return_data->commission == commission, "incorrect returned commission");
+    check(test_name, return_data->max_allowed_commission == max_allowed_commission,
+          "incorrect returned max allowed commission");
+}
+
+
+// Instructions -------------------------------------------------------------------------------------------------------
+
+static uint64_t enter(bool use_commission_caps, uint8_t max_commission, uint8_t max_commission_increase_per_epoch)
+{
+    EnterInstructionData data = { Instruction_Enter, admin.key, use_commission_caps, max_commission,
+                                  max_commission_increase_per_epoch };
+
+    return EXECUTE(data, W(manager_account), W(vote_account), WS(withdrawer), S(withdrawer), R(system_program),
+                   R(vote_program), R(clock_sysvar));
+}
+
+
+static uint64_t set_leave_epoch(HostAccount *authority, uint64_t leave_epoch)
+{
+    SetLeaveEpochInstructionData data = { Instruction_SetLeaveEpoch, leave_epoch };
+
+    return EXECUTE(data, W(manager_account), R(vote_account), S(*authority));
+}
+
+
+static uint64_t leave(HostAccount *authority)
+{
+    uint8_t data = Instruction_Leave;
+
+    return EXECUTE(data, W(manager_account), W(vote_account), S(*authority), W(user), R(vote_program),
+                   R(clock_sysvar));
+}
+
+
+static uint64_t set_authority(Instruction instruction, HostAccount *authority, const HostAccount *new_authority)
+{
+    SetAuthorityInstructionData data = { instruction, new_authority->key };
+
+    if (instruction == Instruction_SetVoteAuthority) {
+        return EXECUTE(data, R(manager_account), W(vote_account), S(*authority), R(vote_program), R(clock_sysvar));
+    }
+
+    return EXECUTE(data, W(manager_account), R(vote_account), S(*authority));
+}
+
+
+static uint64_t set_validator_identity(HostAccount *authority, bool new_identity_signs)
+{
+    uint8_t data = Instruction_SetValidatorIdentity;
+
+    HostAccountRef new_identity = { &new_validator_identity, false, new_identity_signs };
+
+    return EXECUTE(data, R(manager_account), W(vote_account), S(*authority), new_identity, R(vote_program));
+}
+
+
+static uint64_t withdraw(HostAccount *authority, uint64_t lamports)
+{
+    WithdrawInstructionData data = { Instruction_Withdraw, lamports };
+
+    return EXECUTE(data, R(manager_account), W(vote_account), S(*authority), W(user), R(vote_program));
+}
+
+
+static uint64_t set_commission(HostAccount *authority, uint8_t commission)
+{
+    SetCommissionInstructionData data = { Instruction_SetCommission, commission };
+
+    return EXECUTE(data, W(manager_account), W(vote_account), S(*authority), R(vote_program));
+}
+
+
+// Appends an operation to Batch instruction data in data, whose current length is *data_len
+static void batch_add(uint8_t *data, uint64_t *data_len, const uint8_t *account_indices, uint8_t account_count,
+                      const void *operation_data, uint8_t operation_data_len)
+{
+    BatchOperationHeader header = { account_count, operation_data_len };
+
+    memcpy(&(data[*data_len]), &header, sizeof(header));
+    *data_len += sizeof(header);
+    memcpy(&(data[*data_len]), account_indices, account_count);
+    *data_len += account_count;
+    memcpy(&(data[*data_len]), operation_data, operation_data_len);
+    *data_len += operation_data_len;
+}
+
+
+// The accounts of every Batch instruction in the tests; operations reference these by index
+#define BATCH_ACCOUNTS W(manager_account), W(vote_account), S(admin), S(operational_authority), S(rewards_authority), \
+        W(user), S(new_validator_identity), R(vote_program), R(clock_sysvar), S(withdrawer)
+
+static uint64_t batch(const uint8_t *data, uint64_t data_len)
+{
+    HostAccountRef accounts[] = { BATCH_ACCOUNTS };
+
+    return execute(accounts, ARRAY_LEN(accounts), data, data_len);
+}
+
+
+// Enters and sets distinct operational and rewards authorities
+static void enter_and_set_authorities(const char *test_name, bool use_commission_caps, uint8_t max_commission,
+                                      uint8_t max_commission_increase_per_epoch)
+{
+    char name[256];
+
+    snprintf(name, sizeof(name), "%s_setup", test_name);
+    assert_success(name, enter(use_commission_caps, max_commission, max_commission_increase_per_epoch));
+    snprintf(name, sizeof(name), "%s_setup_2", test_name);
+    assert_success(name, set_authority(Instruction_SetOperationalAuthority, &admin, &operational_authority));
+    snprintf(name, sizeof(name), "%s_setup_3", test_name);
+    assert_success(name, set_authority(Instruction_SetRewardsAuthority, &admin, &rewards_authority));
+}
+
+
+// Tests --------------------------------------------------------------------------------------------------------------
+
+static void test_entrypoint()
+{
+    setup();
+
+    uint8_t no_data[1];
+    assert_fail("entrypoint_no_data", Error_InvalidDataSize,
+                execute((HostAccountRef []) { W(manager_account), W(vote_account) }, 2, no_data, 0));
+
+    uint8_t unknown = 200;
+    assert_fail("entrypoint_unknown_instruction", Error_UnknownInstruction, EXECUTE(unknown, W(manager_account)));
+    check("entrypoint_unknown_instruction", host_runtime.find_program_address_count == 0, "PDA search was done");
+}
+
+
+static void test_pubkey_helpers()
+{
+    // The helpers operate on pubkeys at any alignment
+    uint8_t buffer[2 * sizeof(SolPubkey) + 1];
+    SolPubkey *a = (SolPubkey *) &(buffer[1]);
+    SolPubkey b;
+
+    host_make_pubkey(&b, 0x1234);
+    pubkey_copy(a, &b);
+    check("pubkey_helpers", !memcmp(a, &b, sizeof(b)), "pubkey not copied");
+    check("pubkey_helpers", pubkey_equal(a, &b), "equal pubkeys compared unequal");
+
+    // A difference in any byte is detected
+    for (int i = 0; i < (int) sizeof(SolPubkey); i++) {
+        a->x[i] ^= 0x80;
+        check("pubkey_helpers", !pubkey_equal(a, &b), "unequal pubkeys compared equal");
+        a->x[i] ^= 0x80;
+    }
+
+    // Only the all-zeroes pubkey is zero; a nonzero byte anywhere is detected
+    check("pubkey_helpers", !pubkey_is_zero(a), "nonzero pubkey compared zero");
+    memset(a, 0, sizeof(*a));
+    check("pubkey_helpers", pubkey_is_zero(a), "zero pubkey compared nonzero");
+    for (int i = 0; i < (int) sizeof(SolPubkey); i++) {
+        a->x[i] = 1;
+        check("pubkey_helpers", !pubkey_is_zero(a), "nonzero pubkey compared zero");
+        a->x[i] = 0;
+    }
+
+    printf("+ pubkey_helpers\n");
+}
+
+
+static void test_enter()
+{
+    setup();
+
+    EnterInstructionData data = { Instruction_Enter, admin.key, false, 0, 0 };
+    assert_fail("enter_no_vote_account", Error_IncorrectNumberOfAccounts, EXECUTE(data, W(manager_account)));
+
+    assert_fail("enter_short_data", Error_InvalidDataSize,
+                execute((HostAccountRef []) { W(manager_account), W(vote_account), WS(withdrawer), S(withdrawer),
+                                              R(system_program), R(vote_program), R(clock_sysvar) },
+                        7, &data, sizeof(data) - 1));
+
+    assert_fail("enter_not_a_vote_account", Error_InvalidAccount_First + 1,
+                EXECUTE(data, W(manager_account), W(user), WS(withdrawer), S(withdrawer), R(system_program),
+                        R(vote_program), R(clock_sysvar)));
+
+    assert_fail("enter_incorrect_manager_account", Error_InvalidAccount_First,
+                EXECUTE(data, W(user), W(vote_account), WS(withdrawer), S(withdrawer), R(system_program),
+                        R(vote_program), R(clock_sysvar)));
+
+    assert_fail("enter_incorrect_system_program", Error_InvalidAccount_First + 4,
+                EXECUTE(data, W(manager_account), W(vote_account), WS(withdrawer), S(withdrawer), R(vote_program),
+                        R(vote_program), R(clock_sysvar)));
+
+    assert_fail("enter_invalid_max_commission", Error_InvalidData_First + 5, enter(true, 101, 0));
+
+    assert_fail("enter_invalid_max_commission_increase", Error_InvalidData_First + 6, enter(true, 10, 101));
+
+    vote_account.data[HOST_VOTE_COMMISSION_OFFSET] = 20;
+    assert_fail("enter_commission_too_large", Error_CommissionTooLarge, enter(true, 10, 2));
+    vote_account.data[HOST_VOTE_COMMISSION_OFFSET] = 0;
+
+    vote_account.data[HOST_VOTE_VERSION_OFFSET] = 4;
+    assert_fail("enter_unknown_vote_state_version", Error_InvalidAccount_First + 1, enter(true, 10, 2));
+    vote_account.data[HOST_VOTE_VERSION_OFFSET] = 1;
+
+    assert_fail("enter_wrong_withdraw_authority", HOST_ERROR_INVOKE,
+                EXECUTE(data, W(manager_account), W(vote_account), WS(user), S(user), R(system_program),
+                        R(vote_program), R(clock_sysvar)));
+
+    uint64_t withdrawer_lamports = withdrawer.lamports;
+
+    host_runtime.invoke_count = 0;
+    assert_success("enter_success", enter(true, 10, 2));
+
+    check("enter_success", host_runtime.invoke_count == 2, "manager account not created with a single invocation");
+
+    check("enter_success", vote_account_withdrawer_is(&manager_account), "vote withdrawer not set to manager");
+    check("enter_success", SolPubkey_same(&(manager_account.owner), &(Constants.self_program_pubkey)),
+          "manager account not owned by program");
+    check("enter_success", manager_account.data_len == MANAGER_STATE_SIZE, "incorrect manager size");
+    check("enter_success", manager_state()->version == MANAGER_STATE_VERSION, "incorrect manager state version");
+    check("enter_success", manager_account.lamports == rent_exempt_minimum(sizeof(VoteAccountManagerState)),
+          "manager account not funded to rent exempt minimum");
+    check("enter_success", withdrawer.lamports == (withdrawer_lamports - manager_account.lamports),
+          "funding account did not pay for the manager account");
+    check("enter_success", SolPubkey_same(&(manager_state()->withdraw_authority), &(withdrawer.key)),
+          "incorrect withdraw authority");
+    check("enter_success", SolPubkey_same(&(manager_state()->administrator), &(admin.key)), "incorrect administrator");
+    check("enter_success", SolPubkey_same(&(manager_state()->operational_authority), &(admin.key)),
+          "incorrect operational authority");
+    check("enter_success", SolPubkey_same(&(manager_state()->rewards_authority), &(admin.key)),
+          "incorrect rewards authority");
+    check("enter_success", manager_state()->use_commission_caps && (manager_state()->max_commission == 10) &&
+          (manager_state()->max_commission_increase_per_epoch == 2), "incorrect commission caps");
+
+    SolPubkey manager_key;
+    uint8_t bump_seed;
+    host_manager_address(&(vote_account.key), &manager_key, &bump_seed);
+    check("enter_success", manager_state()->bump_seed == bump_seed, "bump seed not stored");
+    check_event("enter_success", Instruction_Enter, manager_account.lamports, &(withdrawer.key), sizeof(SolPubkey),
+                manager_state(), sizeof(VoteAccountManagerState));
+
+    assert_fail("enter_already_entered", Error_ManagerAccountAlreadyExists, enter(false, 0, 0));
+
+    // A manager account that already holds lamports cannot be created with CreateAccount, so it is topped up,
+    // allocated, and assigned instead
+    setup();
+
+    manager_account.lamports = 1000;
+    withdrawer_lamports = withdrawer.lamports;
+
+    host_runtime.invoke_count = 0;
+    assert_success("enter_prefunded", enter(false, 0, 0));
+
+    check("enter_prefunded", host_runtime.invoke_count == 4, "pre-funded manager account not topped up and assigned");
+    check("enter_prefunded", SolPubkey_same(&(manager_account.owner), &(Constants.self_program_pubkey)),
+          "manager account not owned by program");
+    check("enter_prefunded", manager_account.data_len == MANAGER_STATE_SIZE, "incorrect manager size");
+    check("enter_prefunded", manager_account.lamports == rent_exempt_minimum(sizeof(VoteAccountManagerState)),
+          "manager account not funded to rent exempt minimum");
+    check("enter_prefunded", withdrawer.lamports == (withdrawer_lamports - (manager_account.lamports - 1000)),
+          "funding account did not pay the difference");
+}
+
+
+static void test_bump_seed()
+{
+    setup();
+
+    assert_success("bump_seed_setup", enter(false, 0, 0));
+
+    host_runtime.find_program_address_count = 0;
+    host_runtime.create_program_address_count = 0;
+
+    assert_success("bump_seed_stored", set_authority(Instruction_SetAdministrator, &withdrawer, &admin));
+    check("bump_seed_stored", host_runtime.find_program_address_count == 0, "PDA search was done");
+    check("bump_seed_stored", host_runtime.create_program_address_count == 1, "PDA was not created exactly once");
+
+    // Simulate a manager account created before the bump seed was stored
+    uint8_t bump_seed = manager_state()->bump_seed;
+    ((VoteAccountManagerState *) manager_account.data)->bump_seed = 0;
+
+    assert_fail("bump_seed_legacy_read_only", Error_InsufficientLamports, withdraw(&admin, 0));
+    check("bump_seed_legacy_read_only", host_runtime.find_program_address_count == 1, "PDA search was not done");
+
+    assert_success("bump_seed_legacy", set_authority(Instruction_SetAdministrator, &withdrawer, &admin));
+    check("bump_seed_legacy", manager_state()->bump_seed == bump_seed, "bump seed not saved");
+
+    // A wrong bump seed must never validate the manager account
+    ((VoteAccountManagerState *) manager_account.data)->bump_seed = bump_seed - 1;
+    assert_fail("bump_seed_wrong", Error_InvalidAccount_First,
+                set_authority(Instruction_SetAdministrator, &withdrawer, &admin));
+}
+
+
+// Rewrites the manager account in the legacy (version 0) layout, holding the same state
+static void make_legacy_manager_account()
+{
+    VoteAccountManagerState state = *manager_state();
+
+    uint8_t *data = manager_account.data;
+
+    memset(data, 0, MANAGER_STATE_V0_SIZE);
+    memcpy(&(data[MANAGER_STATE_V0_WITHDRAW_AUTHORITY_OFFSET]), &(state.withdraw_authority), sizeof(SolPubkey));
+    memcpy(&(data[MANAGER_STATE_V0_ADMINISTRATOR_OFFSET]), &(state.administrator), sizeof(SolPubkey));
+    memcpy(&(data[MANAGER_STATE_V0_OPERATIONAL_AUTHORITY_OFFSET]), &(state.operational_authority), sizeof(SolPubkey));
+    memcpy(&(data[MANAGER_STATE_V0_REWARDS_AUTHORITY_OFFSET]), &(state.rewards_authority), sizeof(SolPubkey));
+    data[MANAGER_STATE_V0_USE_COMMISSION_CAPS_OFFSET] = state.use_commission_caps;
+    data[MANAGER_STATE_V0_MAX_COMMISSION_OFFSET] = state.max_commission;
+    data[MANAGER_STATE_V0_MAX_COMMISSION_INCREASE_PER_EPOCH_OFFSET] = state.max_commission_increase_per_epoch;
+    uint64_t commission_change_epoch = state.commission_change_epoch;
+    memcpy(&(data[MANAGER_STATE_V0_COMMISSION_CHANGE_EPOCH_OFFSET]), &commission_change_epoch, sizeof(uint64_t));
+    data[MANAGER_STATE_V0_COMMISSION_CHANGE_EPOCH_ORIGINAL_COMMISSION_OFFSET] =
+        state.commission_change_epoch_original_commission;
+    uint64_t leave_epoch = state.leave_epoch;
+    memcpy(&(data[MANAGER_STATE_V0_LEAVE_EPOCH_OFFSET]), &leave_epoch, sizeof(uint64_t));
+    data[MANAGER_STATE_V0_CURRENT_COMMISSION_OFFSET] = state.current_commission;
+    data[MANAGER_STATE_V0_BUMP_SEED_OFFSET] = state.bump_seed;
+
+    manager_account.data_len = MANAGER_STATE_V0_SIZE;
+}
+
+
+static void test_manager_state_layout()
+{
+    setup();
+
+    enter_and_set_authorities("manager_state_layout", true, 10, 2);
+    assert_success("manager_state_layout_setup_4", set_commission(&rewards_authority, 2));
+    assert_success("manager_state_layout_setup_5", set_leave_epoch(&withdrawer, 110));
+
+    VoteAccountManagerState state = *manager_state();
+    check("manager_state_layout_setup_5", (state.commission_change_epoch == 100) && (state.leave_epoch == 110) &&
+          (state.current_commission == 2), "unexpected manager state");
+
+    make_legacy_manager_account();
+
+    // A read-only legacy manager account is used as is, without being converted
+    assert_success("manager_state_layout_legacy_read_only",
+                   set_authority(Instruction_SetVoteAuthority, &operational_authority, &user));
+    check("manager_state_layout_legacy_read_only", manager_account.data_len == MANAGER_STATE_V0_SIZE,
+          "read-only manager account was resized");
+
+    assert_fail("manager_state_layout_legacy_read_only_wrong_authority", Error_InvalidAccount_First + 2,
+                withdraw(&admin, 0));
+
+    // A writable legacy manager account is converted in place
+    assert_success("manager_state_layout_legacy_writable", set_authority(Instruction_SetAdministrator, &withdrawer,
+                                                                         &admin));
+    check("manager_state_layout_legacy_writable", manager_account.data_len == MANAGER_STATE_SIZE,
+          "manager account was not resized");
+    check("manager_state_layout_legacy_writable", !memcmp(manager_state(), &state, sizeof(state)),
+          "manager state was not converted");
+
+    // A legacy manager account with no stored bump seed has it found and saved during conversion
+    uint8_t bump_seed = manager_state()->bump_seed;
+    make_legacy_manager_account();
+    manager_account.data[MANAGER_STATE_V0_BUMP_SEED_OFFSET] = 0;
+    assert_success("manager_state_layout_legacy_no_bump_seed",
+                   set_authority(Instruction_SetAdministrator, &withdrawer, &admin));
+    check("manager_state_layout_legacy_no_bump_seed", manager_state()->bump_seed == bump_seed,
+          "bump seed not saved");
+
+    // Any other version is rejected
+    ((VoteAccountManagerState *) manager_account.data)->version = MANAGER_STATE_VERSION + 1;
+    assert_fail("manager_state_layout_unknown_version", Error_InvalidAccount_First,
+                set_authority(Instruction_SetAdministrator, &withdrawer, &admin));
+}
+
+
+static void test_vote_state_versions()
+{
+    VoteStateFields fields;
+
+    // Version 0 (0.23.5) stores commission far from the start of the account data
+    setup();
+    vote_account.data[HOST_VOTE_VERSION_OFFSET] = 0;
+    vote_account.data[HOST_VOTE_COMMISSION_OFFSET] = 0;
+    memcpy(&(vote_account.data[VOTE_STATE_V0_AUTHORIZED_WITHDRAWER_OFFSET]), &(withdrawer.key), sizeof(SolPubkey));
+    vote_account.data[VOTE_STATE_V0_COMMISSION_OFFSET] = 20;
+    assert_fail("vote_state_v0_commission_too_large", Error_CommissionTooLarge, enter(true, 10, 2));
+    vote_account.data[VOTE_STATE_V0_COMMISSION_OFFSET] = 7;
+    assert_success("vote_state_v0", enter(true, 10, 2));
+    check("vote_state_v0", manager_state()->current_commission == 7, "incorrect commission");
+
+    // Version 1 (1.14.11) and version 2 (current) have the same prefix
+    for (uint8_t version = 1; version <= 2; version++) {
+        setup();
+        vote_account.data[HOST_VOTE_VERSION_OFFSET] = version;
+        vote_account.data[HOST_VOTE_COMMISSION_OFFSET] = 9;
+        assert_success("vote_state_v1_v2", enter(true, 10, 2));
+        check("vote_state_v1_v2", manager_state()->current_commission == 9, "incorrect commission");
+    }
+
+    // Version 3 (V4) stores commission in basis points
+    setup();
+    vote_account.data[HOST_VOTE_VERSION_OFFSET] = 3;
+    uint16_t commission_bps = 800;
+    memcpy(&(vote_account.data[VOTE_STATE_V4_COMMISSION_BPS_OFFSET]), &commission_bps, sizeof(commission_bps));
+    assert_success("vote_state_v4", enter(true, 10, 2));
+    check("vote_state_v4", manager_state()->current_commission == 8, "incorrect commission");
+
+    // The parser never reads beyond the account data
+    vote_account.data[HOST_VOTE_VERSION_OFFSET] = 0;
+    vote_account.data_len = VOTE_STATE_V0_COMMISSION_OFFSET;
+    SolAccountInfo info = { &(vote_account.key), &(vote_account.lamports), vote_account.data_len, vote_account.data,
+                            &(vote_account.owner), 0, false, true, false };
+    check("vote_state_short", !parse_vote_state(&info, &fields), "short version 0 vote state parsed");
+    info.data_len = VOTE_STATE_V0_COMMISSION_OFFSET + 1;
+    check("vote_state_short", parse_vote_state(&info, &fields) &&
+          SolPubkey_same(fields.node_pubkey, (const SolPubkey *) &(vote_account.data[HOST_VOTE_NODE_PUBKEY_OFFSET])),
+          "version 0 vote state not parsed");
+    info.data[HOST_VOTE_VERSION_OFFSET] = 3;
+    info.data_len = VOTE_STATE_V4_COMMISSION_BPS_OFFSET + 1;
+    check("vote_state_short", !parse_vote_state(&info, &fields), "short version 3 vote state parsed");
+    printf("+ vote_state_short\n");
+
+    // SetCommission uses the vote account's commission as the basis of the commission increase limit
+    setup();
+    assert_success("vote_state_cross_check_setup", enter(true, 10, 2));
+    vote_account.data[HOST_VOTE_COMMISSION_OFFSET] = 6;
+    assert_fail("vote_state_cross_check", Error_CommissionChangeTooLarge, set_commission(&admin, 9));
+    assert_success("vote_state_cross_check_2", set_commission(&admin, 8));
+}
+
+
+static void test_set_leave_epoch()
+{
+    setup();
+
+    assert_success("set_leave_epoch_setup", enter(true, 10, 2));
+
+    assert_fail("set_leave_epoch_invalid_withdrawer", Error_InvalidAccount_First + 2, set_leave_epoch(&admin, 110));
+
+    assert_fail("set_leave_epoch_too_soon", Error_InvalidLeaveEpoch, set_leave_epoch(&withdrawer, 101));
+
+    host_runtime.clock_fails = true;
+    assert_fail("set_leave_epoch_no_clock", Error_FailedToGetClock, set_leave_epoch(&withdrawer, 110));
+    host_runtime.clock_fails = false;
+
+    assert_success("set_leave_epoch_success", set_leave_epoch(&withdrawer, 102));
+    check("set_leave_epoch_success", manager_state()->leave_epoch == 102, "leave epoch not set");
+    uint64_t old_leave_epoch = 0, new_leave_epoch = 102;
+    check_event("set_leave_epoch_success", Instruction_SetLeaveEpoch, 0, &old_leave_epoch, sizeof(old_leave_epoch),
+                &new_leave_epoch, sizeof(new_leave_epoch));
+
+    assert_fail("set_leave_epoch_already_set", Error_LeaveEpochAlreadySet, set_leave_epoch(&withdrawer, 110));
+
+    setup();
+
+    assert_success("set_leave_epoch_setup_2", enter(false, 0, 0));
+
+    assert_fail("set_leave_epoch_not_enforcing_commission", Error_CannotSetLeaveEpoch,
+                set_leave_epoch(&withdrawer, 110));
+}
+
+
+static void test_leave()
+{
+    setup();
+
+    assert_success("leave_setup", enter(true, 10, 2));
+
+    assert_fail("leave_invalid_withdrawer", Error_InvalidAccount_First + 2, leave(&admin));
+
+    assert_fail("leave_not_set", Error_LeaveEpochNotSet, leave(&withdrawer));
+
+    assert_success("leave_setup_2", set_leave_epoch(&withdrawer, 102));
+
+    assert_fail("leave_too_soon", Error_CannotLeaveYet, leave(&withdrawer));
+
+    host_runtime.epoch = 102;
+
+    uint64_t user_lamports = user.lamports;
+    uint64_t manager_lamports = manager_account.lamports;
+    VoteAccountManagerState state = *manager_state();
+
+    assert_success("leave_success", leave(&withdrawer));
+    check_event("leave_success", Instruction_Leave, manager_lamports, &state, sizeof(state), &(withdrawer.key),
+                sizeof(SolPubkey));
+    check("leave_success", vote_account_withdrawer_is(&withdrawer), "vote withdrawer not restored");
+    check("leave_success", manager_account.lamports == 0, "manager account lamports not removed");
+    check("leave_success", manager_account.data_len == 0, "manager account data not removed");
+    check("leave_success", user.lamports == (user_lamports + manager_lamports), "manager lamports not returned");
+
+    setup();
+
+    assert_success("leave_setup_3", enter(false, 0, 0));
+
+    assert_success("leave_success_2", leave(&withdrawer));
+}
+
+
+static void test_set_authorities()
+{
+    setup();
+
+    assert_success("set_administrator_setup", enter(false, 0, 0));
+
+    assert_fail("set_administrator_invalid_withdrawer", Error_InvalidAccount_First + 2,
+                set_authority(Instruction_SetAdministrator, &admin, &user));
+    assert_success("set_administrator_success", set_authority(Instruction_SetAdministrator, &withdrawer, &user));
+    check("set_administrator_success", SolPubkey_same(&(manager_state()->administrator), &(user.key)),
+          "administrator not set");
+    check_event("set_administrator_success", Instruction_SetAdministrator, 0, &(admin.key), sizeof(SolPubkey),
+                &(user.key), sizeof(SolPubkey));
+    assert_success("set_administrator_success_2", set_authority(Instruction_SetAdministrator, &withdrawer, &admin));
+
+    assert_fail("set_operational_authority_invalid_administrator", Error_InvalidAccount_First + 2,
+                set_authority(Instruction_SetOperationalAuthority, &withdrawer, &operational_authority));
+    assert_success("set_operational_authority_success",
+                   set_authority(Instruction_SetOperationalAuthority, &admin, &operational_authority));
+    check("set_operational_authority_success",
+          SolPubkey_same(&(manager_state()->operational_authority), &(operational_authority.key)),
+          "operational authority not set");
+
+    assert_fail("set_rewards_authority_invalid_administrator", Error_InvalidAccount_First + 2,
+                set_authority(Instruction_SetRewardsAuthority, &withdrawer, &rewards_authority));
+    assert_success("set_rewards_authority_success",
+                   set_authority(Instruction_SetRewardsAuthority, &admin, &rewards_authority));
+    check("set_rewards_authority_success",
+          SolPubkey_same(&(manager_state()->rewards_authority), &(rewards_authority.key)),
+          "rewards authority not set");
+
+    assert_fail("set_vote_authority_invalid_operational_authority", Error_InvalidAccount_First + 2,
+                set_authority(Instruction_SetVoteAuthority, &admin, &user));
+    assert_success("set_vote_authority_success",
+                   set_authority(Instruction_SetVoteAuthority, &operational_authority, &user));
+    check("set_vote_authority_success", SolPubkey_same(&(host_runtime.authorized_voter), &(user.key)),
+          "vote authority not set");
+    check_event("set_vote_authority_success", Instruction_SetVoteAuthority, 0, 0, 0, &(user.key), sizeof(SolPubkey));
+}
+
+
+static void test_set_validator_identity()
+{
+    setup();
+
+    enter_and_set_authorities("set_validator_identity", false, 0, 0);
+
+    assert_fail("set_validator_identity_invalid_operational_authority", Error_InvalidAccount_First + 2,
+                set_validator_identity(&admin, true));
+
+    assert_fail("set_validator_identity_new_identity_not_signer", Error_InvalidAccountPermissions_First + 3,
+                set_validator_identity(&operational_authority, false));
+
+    SolPubkey old_validator_identity;
+    memcpy(&old_validator_identity, &(vote_account.data[HOST_VOTE_NODE_PUBKEY_OFFSET]), sizeof(SolPubkey));
+
+    assert_success("set_validator_identity_success", set_validator_identity(&operational_authority, true));
+    check_event("set_validator_identity_success", Instruction_SetValidatorIdentity, 0, &old_validator_identity,
+                sizeof(SolPubkey), &(new_validator_identity.key), sizeof(SolPubkey));
+    check("set_validator_identity_success",
+          !memcmp(&(vote_account.data[HOST_VOTE_NODE_PUBKEY_OFFSET]), &(new_validator_identity.key),
+                  sizeof(SolPubkey)), "validator identity not set");
+}
+
+
+static void test_withdraw()
+{
+    setup();
+
+    enter_and_set_authorities("withdraw", false, 0, 0);
+
+    assert_fail("withdraw_invalid_rewards_authority", Error_InvalidAccount_First + 2, withdraw(&user, 0));
+
+    assert_fail("withdraw_invalid_no_rewards", Error_InsufficientLamports, withdraw(&rewards_authority, 0));
+
+    // Simulate 5 SOL of rewards
+    vote_account.lamports += 5000000000ul;
+
+    assert_fail("withdraw_too_much", Error_InsufficientLamports,
+                withdraw(&rewards_authority, vote_account.lamports + 1));
+
+    uint64_t user_lamports = user.lamports;
+    uint64_t vote_account_lamports = vote_account.lamports;
+
+    assert_success("withdraw_success_1", withdraw(&rewards_authority, 1000000000ul));
+    check("withdraw_success_1", user.lamports == (user_lamports + 1000000000ul), "user balance did not increase");
+    check("withdraw_success_1", vote_account.lamports == (vote_account_lamports - 1000000000ul),
+          "vote account balance did not decrease");
+    check_event("withdraw_success_1", Instruction_Withdraw, 1000000000ul, 0, 0, &(user.key), sizeof(SolPubkey));
+    check("withdraw_success_1", return_data_u64("withdraw_success_1") == 1000000000ul,
+          "incorrect returned lamports");
+
+    user_lamports = user.lamports;
+    vote_account_lamports = vote_account.lamports;
+
+    assert_success("withdraw_success_remainder", withdraw(&rewards_authority, 0));
+    check("withdraw_success_remainder", vote_account.lamports == rent_exempt_minimum(HOST_VOTE_ACCOUNT_SIZE),
+          "vote account was not reduced to rent exempt minimum");
+    check("withdraw_success_remainder", (user.lamports - user_lamports) ==
+          (vote_account_lamports - vote_account.lamports), "user balance did not increase by withdrawn amount");
+    check("withdraw_success_remainder", return_data_u64("withdraw_success_remainder") ==
+          (vote_account_lamports - vote_account.lamports), "incorrect returned lamports");
+}
+
+
+static void test_set_commission()
+{
+    setup();
+
+    enter_and_set_authorities("set_commission", true, 50, 2);
+
+    assert_fail("set_commission_invalid_rewards_authority", Error_InvalidAccount_First + 2,
+                set_commission(&user, 10));
+
+    assert_fail("set_commission_too_large", Error_CommissionTooLarge, set_commission(&rewards_authority, 51));
+
+    assert_fail("set_commission_change_too_large", Error_CommissionChangeTooLarge,
+                set_commission(&rewards_authority, 3));
+
+    assert_success("set_commission_increment_1", set_commission(&rewards_authority, 1));
+    check("set_commission_increment_1", vote_account_commission() == 1, "commission not set");
+    uint8_t old_commission = 0, new_commission = 1;
+    check_event("set_commission_increment_1", Instruction_SetCommission, 0, &old_commission, sizeof(old_commission),
+                &new_commission, sizeof(new_commission));
+    check_commission_return_data("set_commission_increment_1", 1, 2);
+
+    assert_success("set_commission_increment_2", set_commission(&rewards_authority, 2));
+
+    assert_fail("set_commission_increment_too_large", Error_CommissionChangeTooLarge,
+                set_commission(&rewards_authority, 3));
+
+    assert_success("set_commission_decrement", set_commission(&rewards_authority, 0));
+
+    assert_success("set_commission_increment_3", set_commission(&rewards_authority, 2));
+
+    host_runtime.epoch++;
+
+    assert_fail("set_commission_next_epoch_too_large", Error_CommissionChangeTooLarge,
+                set_commission(&rewards_authority, 5));
+
+    assert_success("set_commission_next_epoch", set_commission(&rewards_authority, 4));
+    check("set_commission_next_epoch", vote_account_commission() == 4, "commission not set");
+    check("set_commission_next_epoch", manager_state()->current_commission == 4, "current commission not saved");
+    check_commission_return_data("set_commission_next_epoch", 4, 4);
+
+    assert_success("set_commission_set_leave_epoch", set_leave_epoch(&withdrawer, host_runtime.epoch + 2));
+
+    assert_fail("set_commission_leave_epoch_set", Error_LeaveEpochAlreadySet, set_commission(&rewards_authority, 3));
+
+    setup();
+
+    enter_and_set_authorities("set_commission_no_caps", false, 0, 0);
+
+    assert_success("set_commission_no_caps_success", set_commission(&rewards_authority, 100));
+    check("set_commission_no_caps_success", vote_account_commission() == 100, "commission not set");
+    check_commission_return_data("set_commission_no_caps_success", 100, 100);
+}
+
+
+static void test_batch()
+{
+    setup();
+
+    assert_success("batch_setup", enter(true, 50, 2));
+
+    uint8_t data[256] = { Instruction_Batch, 2 };
+    uint64_t data_len = sizeof(BatchInstructionData);
+
+    // Set the operational and rewards authorities in one instruction, both signed by the administrator
+    SetAuthorityInstructionData set_operational_authority_data = { Instruction_SetOperationalAuthority,
+                                                                   operational_authority.key };
+    SetAuthorityInstructionData set_rewards_authority_data = { Instruction_SetRewardsAuthority,
+                                                               rewards_authority.key };
+    uint8_t admin_indices[] = { 0, 1, 2 };
+    batch_add(data, &data_len, admin_indices, 3, &set_operational_authority_data,
+              sizeof(set_operational_authority_data));
+    batch_add(data, &data_len, admin_indices, 3, &set_rewards_authority_data, sizeof(set_rewards_authority_data));
+
+    assert_fail("batch_trailing_data", Error_InvalidDataSize, batch(data, data_len + 1));
+
+    assert_fail("batch_truncated", Error_InvalidDataSize, batch(data, data_len - 1));
+
+    host_runtime.find_program_address_count = host_runtime.create_program_address_count = 0;
+
+    assert_success("batch_set_authorities", batch(data, data_len));
+    check("batch_set_authorities", !memcmp(&(manager_state()->operational_authority), &(operational_authority.key),
+                                           sizeof(SolPubkey)), "operational authority not set");
+    check("batch_set_authorities", !memcmp(&(manager_state()->rewards_authority), &(rewards_authority.key),
+                                           sizeof(SolPubkey)), "rewards authority not set");
+    check("batch_set_authorities",
+          (host_runtime.find_program_address_count + host_runtime.create_program_address_count) == 1,
+          "manager account was not verified exactly once");
+
+    // Withdraw, then set commission, then change validator identity
+    vote_account.lamports += 5000000000ul;
+    uint64_t user_lamports = user.lamports;
+    host_runtime.clock_sysvar_count = host_runtime.rent_sysvar_count = 0;
+    host_runtime.log_data_count = 0;
+
+    data[1] = 3;
+    data_len = sizeof(BatchInstructionData);
+    WithdrawInstructionData withdraw_data = { Instruction_Withdraw, 1000000000ul };
+    uint8_t withdraw_indices[] = { 0, 1, 4, 5, 7 };
+    batch_add(data, &data_len, withdraw_indices, 5, &withdraw_data, sizeof(withdraw_data));
+    SetCommissionInstructionData set_commission_data = { Instruction_SetCommission, 2 };
+    uint8_t set_commission_indices[] = { 0, 1, 4, 7 };
+    batch_add(data, &data_len, set_commission_indices, 4, &set_commission_data, sizeof(set_commission_data));
+    uint8_t set_validator_identity_data = Instruction_SetValidatorIdentity;
+    uint8_t set_validator_identity_indices[] = { 0, 1, 3, 6, 7 };
+    batch_add(data, &data_len, set_validator_identity_indices, 5, &set_validator_identity_data, 1);
+
+    assert_success("batch_withdraw_commission_identity", batch(data, data_len));
+    check("batch_withdraw_commission_identity", user.lamports == (user_lamports + 1000000000ul),
+          "user balance did not increase");
+    check("batch_withdraw_commission_identity", vote_account_commission() == 2, "commission not set");
+    check("batch_withdraw_commission_identity", host_runtime.rent_sysvar_count == 1, "rent not fetched once");
+    check("batch_withdraw_commission_identity", host_runtime.clock_sysvar_count == 1, "clock not fetched once");
+    check("batch_withdraw_commission_identity", host_runtime.log_data_count == 3, "one event not logged per operation");
+    SolPubkey old_validator_identity;
+    host_make_pubkey(&old_validator_identity, 0x40de);
+    check_event("batch_withdraw_commission_identity", Instruction_SetValidatorIdentity, 0, &old_validator_identity,
+                sizeof(SolPubkey), &(new_validator_identity.key), sizeof(SolPubkey));
+    check("batch_withdraw_commission_identity",
+          !memcmp(&(vote_account.data[HOST_VOTE_NODE_PUBKEY_OFFSET]), &(new_validator_identity.key),
+                  sizeof(SolPubkey)), "validator identity not set");
+
+    // If any operation fails, no operation takes effect
+    user_lamports = user.lamports;
+    data[1] = 2;
+    data_len = sizeof(BatchInstructionData);
+    batch_add(data, &data_len, withdraw_indices, 5, &withdraw_data, sizeof(withdraw_data));
+    set_commission_data.commission = 5;
+    batch_add(data, &data_len, set_commission_indices, 4, &set_commission_data, sizeof(set_commission_data));
+
+    assert_fail("batch_second_operation_fails", Error_CommissionChangeTooLarge, batch(data, data_len));
+    check("batch_second_operation_fails", user.lamports == user_lamports, "withdraw took effect");
+
+    // Operations must use the manager account and vote account
+    data[1] = 1;
+    data_len = sizeof(BatchInstructionData);
+    uint8_t wrong_manager_indices[] = { 1, 1, 4, 5, 7 };
+    batch_add(data, &data_len, wrong_manager_indices, 5, &withdraw_data, sizeof(withdraw_data));
+    assert_fail("batch_wrong_manager_account", Error_InvalidAccount_First, batch(data, data_len));
+
+    data_len = sizeof(BatchInstructionData);
+    uint8_t wrong_vote_indices[] = { 0, 5, 4, 5, 7 };
+    batch_add(data, &data_len, wrong_vote_indices, 5, &withdraw_data, sizeof(withdraw_data));
+    assert_fail("batch_wrong_vote_account", Error_InvalidAccount_First + 1, batch(data, data_len));
+
+    data_len = sizeof(BatchInstructionData);
+    uint8_t out_of_range_indices[] = { 0, 1, 4, 5, 200 };
+    batch_add(data, &data_len, out_of_range_indices, 5, &withdraw_data, sizeof(withdraw_data));
+    assert_fail("batch_account_out_of_range", Error_IncorrectNumberOfAccounts, batch(data, data_len));
+
+    // Only operations on an existing manager account that leave it in place are allowed
+    data_len = sizeof(BatchInstructionData);
+    uint8_t leave_data = Instruction_Leave;
+    uint8_t leave_indices[] = { 0, 1, 9, 5, 7, 8 };
+    batch_add(data, &data_len, leave_indices, 6, &leave_data, 1);
+    assert_fail("batch_leave_not_allowed", Error_InstructionNotAllowedInBatch, batch(data, data_len));
+
+    data_len = sizeof(BatchInstructionData);
+    uint8_t nested_data[] = { Instruction_Batch, 0 };
+    batch_add(data, &data_len, admin_indices, 3, nested_data, sizeof(nested_data));
+    assert_fail("batch_nested_not_allowed", Error_InstructionNotAllowedInBatch, batch(data, data_len));
+}
+
+
+static void test_fleet()
+{
+    setup();
+
+    enter_and_set_authorities("fleet", true, 50, 5);
+
+    // A second vote account and manager account, with the same rewards authority
+    static HostAccount vote_account2, manager_account2;
+    SolPubkey key;
+    uint8_t bump_seed;
+    host_make_pubkey(&key, 8);
+    host_make_vote_account(&vote_account2, &key, &(withdrawer.key), 0, 27074400);
+    host_manager_address(&(vote_account2.key), &key, &bump_seed);
+    host_make_account(&manager_account2, &key, &(Constants.system_program_pubkey), 0, 0);
+
+    EnterInstructionData enter_data = { Instruction_Enter, admin.key, true, 50, 5 };
+    assert_success("fleet_setup_4", EXECUTE(enter_data, W(manager_account2), W(vote_account2), WS(withdrawer),
+                                            S(withdrawer), R(system_program), R(vote_program), R(clock_sysvar)));
+    SetAuthorityInstructionData set_rewards_authority_data = { Instruction_SetRewardsAuthority,
+                                                               rewards_authority.key };
+    assert_success("fleet_setup_5", EXECUTE(set_rewards_authority_data, W(manager_account2), R(vote_account2),
+                                            S(admin)));
+
+    uint8_t fleet_withdraw_data = Instruction_FleetWithdraw;
+
+    assert_fail("fleet_withdraw_odd_accounts", Error_IncorrectNumberOfAccounts,
+                EXECUTE(fleet_withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), R(manager_account2)));
+
+    assert_fail("fleet_withdraw_wrong_manager_account", Error_InvalidAccount_First + 5,
+                EXECUTE(fleet_withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), R(manager_account), W(vote_account2)));
+
+    assert_fail("fleet_withdraw_vote_account_not_writable", Error_InvalidAccountPermissions_First + 6,
+                EXECUTE(fleet_withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), R(manager_account2), R(vote_account2)));
+
+    assert_fail("fleet_withdraw_nothing_to_withdraw", Error_InsufficientLamports,
+                EXECUTE(fleet_withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), R(manager_account2), W(vote_account2)));
+
+    // Rewards in the second vote account only; the first is skipped
+    vote_account2.lamports += 2000000000ul;
+    uint64_t user_lamports = user.lamports;
+
+    host_runtime.find_program_address_count = host_runtime.create_program_address_count = 0;
+    host_runtime.rent_sysvar_count = 0;
+
+    assert_success("fleet_withdraw_success", EXECUTE(fleet_withdraw_data, R(manager_account), W(vote_account),
+                                                     S(rewards_authority), W(user), R(vote_program),
+                                                     R(manager_account2), W(vote_account2)));
+    check("fleet_withdraw_success", user.lamports == (user_lamports + 2000000000ul), "user balance did not increase");
+    check("fleet_withdraw_success", vote_account2.lamports == rent_exempt_minimum(HOST_VOTE_ACCOUNT_SIZE),
+          "vote account was not reduced to rent exempt minimum");
+    check("fleet_withdraw_success", host_runtime.find_program_address_count == 0, "PDA search was done");
+    check("fleet_withdraw_success", host_runtime.create_program_address_count == 2,
+          "manager accounts were not each verified once");
+    check("fleet_withdraw_success", host_runtime.rent_sysvar_count == 1, "rent not fetched once");
+    check("fleet_withdraw_success", return_data_u64("fleet_withdraw_success") == 2000000000ul,
+          "incorrect returned lamports");
+
+    // The second vote account's rewards authority differs
+    SetAuthorityInstructionData set_rewards_authority_user_data = { Instruction_SetRewardsAuthority, user.key };
+    assert_success("fleet_setup_6", EXECUTE(set_rewards_authority_user_data, W(manager_account2), R(vote_account2),
+                                            S(admin)));
+    vote_account.lamports += 1000000000ul;
+    vote_account2.lamports += 1000000000ul;
+    assert_fail("fleet_withdraw_wrong_rewards_authority", Error_InvalidAccount_First + 2,
+                EXECUTE(fleet_withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), R(manager_account2), W(vote_account2)));
+    assert_success("fleet_setup_7", EXECUTE(set_rewards_authority_data, W(manager_account2), R(vote_account2),
+                                            S(admin)));
+
+    SetCommissionInstructionData fleet_set_commission_data = { Instruction_FleetSetCommission, 4 };
+
+    assert_fail("fleet_set_commission_manager_not_writable", Error_InvalidAccountPermissions_First + 4,
+                EXECUTE(fleet_set_commission_data, W(manager_account), W(vote_account), S(rewards_authority),
+                        R(vote_program), R(manager_account2), W(vote_account2)));
+
+    host_runtime.clock_sysvar_count = 0;
+
+    assert_success("fleet_set_commission_success",
+                   EXECUTE(fleet_set_commission_data, W(manager_account), W(vote_account), S(rewards_authority),
+                           R(vote_program), W(manager_account2), W(vote_account2)));
+    check("fleet_set_commission_success", vote_account_commission() == 4, "commission not set");
+    check("fleet_set_commission_success", vote_account2.data[HOST_VOTE_COMMISSION_OFFSET] == 4,
+          "second commission not set");
+    check("fleet_set_commission_success", host_runtime.clock_sysvar_count == 1, "clock not fetched once");
+
+    // Commission caps of every vote account are enforced
+    fleet_set_commission_data.commission = 6;
+    assert_fail("fleet_set_commission_change_too_large", Error_CommissionChangeTooLarge,
+                EXECUTE(fleet_set_commission_data, W(manager_account), W(vote_account), S(rewards_authority),
+                        R(vote_program), W(manager_account2), W(vote_account2)));
+    check("fleet_set_commission_change_too_large", vote_account_commission() == 4, "commission changed");
+
+    // Many more vote accounts than once fit in the program's fixed account array
+    static HostAccount fleet_vote_accounts[24], fleet_manager_accounts[24];
+    HostAccountRef refs[5 + (2 * ARRAY_LEN(fleet_vote_accounts))] = { R(manager_account), W(vote_account),
+                                                                       S(rewards_authority), W(user),
+                                                                       R(vote_program) };
+    for (uint64_t i = 0; i < ARRAY_LEN(fleet_vote_accounts); i++) {
+        host_make_pubkey(&key, 100 + i);
+        host_make_vote_account(&(fleet_vote_accounts[i]), &key, &(withdrawer.key), 0, 27074400);
+        host_manager_address(&(fleet_vote_accounts[i].key), &key, &bump_seed);
+        host_make_account(&(fleet_manager_accounts[i]), &key, &(Constants.system_program_pubkey), 0, 0);
+        assert_success("fleet_many_setup", EXECUTE(enter_data, W(fleet_manager_accounts[i]),
+                                                   W(fleet_vote_accounts[i]), WS(withdrawer), S(withdrawer),
+                                                   R(system_program), R(vote_program), R(clock_sysvar)));
+        assert_success("fleet_many_setup_2", EXECUTE(set_rewards_authority_data, W(fleet_manager_accounts[i]),
+                                                     R(fleet_vote_accounts[i]), S(admin)));
+        fleet_vote_accounts[i].lamports += 1000000000ul;
+        refs[5 + (2 * i)] = (HostAccountRef) R(fleet_manager_accounts[i]);
+        refs[5 + (2 * i) + 1] = (HostAccountRef) W(fleet_vote_accounts[i]);
+    }
+
+    user_lamports = user.lamports;
+    assert_success("fleet_many_withdraw", execute(refs, ARRAY_LEN(refs), &fleet_withdraw_data,
+                                                  sizeof(fleet_withdraw_data)));
+    check("fleet_many_withdraw",
+          user.lamports == (user_lamports + (1000000000ul * (ARRAY_LEN(fleet_vote_accounts) + 1))),
+          "user balance did not increase by the rewards of every vote account");
+
+    // More accounts than the program accepts
+    HostAccountRef too_many_refs[MAX_ACCOUNTS + 1];
+    for (uint64_t i = 0; i < ARRAY_LEN(too_many_refs); i++) {
+        too_many_refs[i] = (HostAccountRef) R(user);
+    }
+    assert_fail("fleet_too_many_accounts", Error_IncorrectNumberOfAccounts,
+                execute(too_many_refs, ARRAY_LEN(too_many_refs), &fleet_withdraw_data, sizeof(fleet_withdraw_data)));
+}
+
+
+static void test_revenue_split()
+{
+    setup();
+
+    enter_and_set_authorities("revenue_split", false, 0, 0);
+
+    static HostAccount recipient1, recipient2;
+    SolPubkey key;
+    host_make_pubkey(&key, 9);
+    host_make_account(&recipient1, &key, &(Constants.system_program_pubkey), 1000000000ul, 0);
+    host_make_pubkey(&key, 10);
+    host_make_account(&recipient2, &key, &(Constants.system_program_pubkey), 1000000000ul, 0);
+
+    // 25% to recipient1 and 10% to recipient2
+    SetRevenueSplitInstructionData data = { Instruction_SetRevenueSplit, { 2, { { recipient1.key, 2500 },
+                                                                                { recipient2.key, 1000 } } } };
+    uint64_t data_len = __builtin_offsetof(SetRevenueSplitInstructionData, revenue_split.recipients) +
+        (2 * sizeof(RevenueSplitRecipient));
+
+#define SET_REVENUE_SPLIT(authority)                                                                                  \
+    execute((HostAccountRef []) { W(manager_account), R(vote_account), S(authority), WS(admin), R(system_program) },  \
+            5, &data, data_len)
+
+    assert_fail("revenue_split_invalid_administrator", Error_InvalidAccount_First + 2, SET_REVENUE_SPLIT(user));
+
+    data_len--;
+    assert_fail("revenue_split_short_data", Error_InvalidDataSize, SET_REVENUE_SPLIT(admin));
+    data_len++;
+
+    data.revenue_split.recipients[1].share_bps = 7501;
+    assert_fail("revenue_split_too_large", Error_InvalidRevenueSplit, SET_REVENUE_SPLIT(admin));
+    data.revenue_split.recipients[1].share_bps = 0;
+    assert_fail("revenue_split_zero_share", Error_InvalidRevenueSplit, SET_REVENUE_SPLIT(admin));
+    data.revenue_split.recipients[1].share_bps = 1000;
+
+    data.revenue_split.recipients[1].recipient = recipient1.key;
+    assert_fail("revenue_split_duplicate_recipient", Error_InvalidRevenueSplit, SET_REVENUE_SPLIT(admin));
+    data.revenue_split.recipients[1].recipient = manager_account.key;
+    assert_fail("revenue_split_manager_recipient", Error_InvalidRevenueSplit, SET_REVENUE_SPLIT(admin));
+    data.revenue_split.recipients[1].recipient = recipient2.key;
+
+    uint64_t admin_lamports = admin.lamports;
+
+    assert_success("revenue_split_set", SET_REVENUE_SPLIT(admin));
+    check("revenue_split_set", manager_account.data_len == MANAGER_STATE_REVENUE_SPLIT_END,
+          "manager account was not grown");
+    check("revenue_split_set", manager_account.lamports == rent_exempt_minimum(MANAGER_STATE_REVENUE_SPLIT_END),
+          "manager account not funded to rent exempt minimum");
+    check("revenue_split_set", admin.lamports == (admin_lamports - (rent_exempt_minimum(MANAGER_STATE_REVENUE_SPLIT_END)
+                                                                   - rent_exempt_minimum(MANAGER_STATE_SIZE))),
+          "funding account did not pay for the growth");
+    check("revenue_split_set", !memcmp(&(manager_account.data[MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET]),
+                                       &(data.revenue_split), data_len - 1), "revenue split not stored");
+
+    // Simulate 1 SOL + 1 lamport of rewards
+    vote_account.lamports += 1000000001ul;
+
+    WithdrawInstructionData withdraw_data = { Instruction_Withdraw, 0 };
+
+    assert_fail("revenue_split_withdraw_no_recipients", Error_IncorrectNumberOfAccounts,
+                withdraw(&rewards_authority, 0));
+
+    assert_fail("revenue_split_withdraw_wrong_order", Error_InvalidAccount_First + 5,
+                EXECUTE(withdraw_data, W(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), W(recipient2), W(recipient1)));
+
+    assert_fail("revenue_split_withdraw_recipient_not_writable", Error_InvalidAccountPermissions_First + 6,
+                EXECUTE(withdraw_data, W(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), W(recipient1), R(recipient2)));
+
+    assert_fail("revenue_split_withdraw_manager_not_writable", Error_InvalidAccountPermissions_First,
+                EXECUTE(withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program), W(recipient1), W(recipient2)));
+
+    uint64_t manager_lamports = manager_account.lamports;
+    uint64_t user_lamports = user.lamports;
+    uint64_t recipient1_lamports = recipient1.lamports;
+    uint64_t recipient2_lamports = recipient2.lamports;
+    host_runtime.invoke_count = 0;
+
+    assert_success("revenue_split_withdraw",
+                   EXECUTE(withdraw_data, W(manager_account), W(vote_account), S(rewards_authority), W(user),
+                           R(vote_program), W(recipient1), W(recipient2)));
+    check("revenue_split_withdraw", host_runtime.invoke_count == 1, "withdraw was not a single invocation");
+    check("revenue_split_withdraw", recipient1.lamports == (recipient1_lamports + 250000000ul),
+          "first recipient not paid its share");
+    check("revenue_split_withdraw", recipient2.lamports == (recipient2_lamports + 100000000ul),
+          "second recipient not paid its share");
+    check("revenue_split_withdraw", user.lamports == (user_lamports + 650000001ul),
+          "recipient account not paid the remainder");
+    check("revenue_split_withdraw", manager_account.lamports == manager_lamports,
+          "manager account balance changed");
+
+    // A share too small to make an empty recipient rent exempt is carried over to the recipient account, rather than
+    // failing the withdraw, and an empty recipient whose share is large enough is paid as usual
+    vote_account.lamports += 1000000ul;
+    recipient2.lamports = 0;
+    user_lamports = user.lamports;
+    recipient1_lamports = recipient1.lamports;
+
+    assert_success("revenue_split_withdraw_share_below_rent",
+                   EXECUTE(withdraw_data, W(manager_account), W(vote_account), S(rewards_authority), W(user),
+                           R(vote_program), W(recipient1), W(recipient2)));
+    check("revenue_split_withdraw_share_below_rent", recipient1.lamports == (recipient1_lamports + 250000ul),
+          "first recipient not paid its share");
+    check("revenue_split_withdraw_share_below_rent", recipient2.lamports == 0,
+          "second recipient paid a share below rent exemption");
+    check("revenue_split_withdraw_share_below_rent", user.lamports == (user_lamports + 750000ul),
+          "recipient account not paid the carried over share");
+    check("revenue_split_withdraw_share_below_rent", manager_account.lamports == manager_lamports,
+          "manager account balance changed");
+
+    vote_account.lamports += 10000000ul;
+
+    assert_success("revenue_split_withdraw_share_above_rent",
+                   EXECUTE(withdraw_data, W(manager_account), W(vote_account), S(rewards_authority), W(user),
+                           R(vote_program), W(recipient1), W(recipient2)));
+    check("revenue_split_withdraw_share_above_rent", recipient2.lamports == 1000000ul,
+          "empty recipient not paid a share above rent exemption");
+
+    // A vote account with a revenue split cannot be withdrawn from by FleetWithdraw
+    vote_account.lamports += 1000000000ul;
+    uint8_t fleet_withdraw_data = Instruction_FleetWithdraw;
+    assert_fail("revenue_split_fleet_withdraw", Error_IncorrectNumberOfAccounts,
+                EXECUTE(fleet_withdraw_data, W(manager_account), W(vote_account), S(rewards_authority), W(user),
+                        R(vote_program)));
+
+    // Removing the revenue split restores the plain Withdraw
+    data.revenue_split.recipient_count = 0;
+    data_len = __builtin_offsetof(SetRevenueSplitInstructionData, revenue_split.recipients);
+    assert_success("revenue_split_remove", SET_REVENUE_SPLIT(admin));
+    assert_success("revenue_split_removed_withdraw", withdraw(&rewards_authority, 0));
+
+#undef SET_REVENUE_SPLIT
+}
+
+
+static void test_sweep()
+{
+    setup();
+
+    enter_and_set_authorities("sweep", false, 0, 0);
+
+    static HostAccount keeper, split_recipient;
+    SolPubkey key;
+    host_make_pubkey(&key, 11);
+    host_make_account(&keeper, &key, &(Constants.system_program_pubkey), 1000000000ul, 0);
+    host_make_pubkey(&key, 12);
+    host_make_account(&split_recipient, &key, &(Constants.system_program_pubkey), 1000000000ul, 0);
+
+    uint8_t sweep_data = Instruction_Sweep;
+
+    vote_account.lamports += 3000000000ul;
+
+    assert_fail("sweep_not_set", Error_SweepNotSet,
+                EXECUTE(sweep_data, R(manager_account), W(vote_account), W(user), R(vote_program)));
+
+    // Sweep to user once at least 2 SOL are available
+    SetSweepInstructionData data = { Instruction_SetSweep, user.key, 2000000000ul };
+
+#define SET_SWEEP(authority)                                                                                          \
+    EXECUTE(data, W(manager_account), R(vote_account), S(authority), WS(admin), R(system_program))
+
+    assert_fail("sweep_set_invalid_rewards_authority", Error_InvalidAccount_First + 2, SET_SWEEP(admin));
+
+    assert_success("sweep_set", SET_SWEEP(rewards_authority));
+    check("sweep_set", manager_account.data_len == MANAGER_STATE_SWEEP_END, "manager account was not grown");
+    check("sweep_set", manager_account.lamports == rent_exempt_minimum(MANAGER_STATE_SWEEP_END),
+          "manager account not funded to rent exempt minimum");
+    check("sweep_set", manager_account.data[MANAGER_STATE_REVENUE_SPLIT_COUNT_OFFSET] == 0,
+          "revenue split was set by growth");
+
+    assert_fail("sweep_wrong_recipient", Error_InvalidAccount_First + 2,
+                EXECUTE(sweep_data, R(manager_account), W(vote_account), W(keeper), R(vote_program)));
+
+    // There is no revenue split, so no accounts may follow the vote program id
+    assert_fail("sweep_extra_account", Error_IncorrectNumberOfAccounts,
+                EXECUTE(sweep_data, R(manager_account), W(vote_account), W(user), R(vote_program), W(keeper)));
+
+    uint64_t user_lamports = user.lamports;
+
+    assert_success("sweep_success",
+                   EXECUTE(sweep_data, R(manager_account), W(vote_account), W(user), R(vote_program)));
+    check("sweep_success", user.lamports == (user_lamports + 3000000000ul), "recipient was not paid");
+
+    // Below the minimum
+    vote_account.lamports += 1999999999ul;
+    assert_fail("sweep_below_minimum", Error_InsufficientLamports,
+                EXECUTE(sweep_data, R(manager_account), W(vote_account), W(user), R(vote_program)));
+
+    // Sweeps pay the revenue split
+    vote_account.lamports += 1ul;
+    SetRevenueSplitInstructionData split_data = { Instruction_SetRevenueSplit,
+                                                  { 1, { { split_recipient.key, 5000 } } } };
+    assert_success("sweep_revenue_split_set",
+                   execute((HostAccountRef []) { W(manager_account), R(vote_account), S(admin), WS(admin),
+                                                 R(system_program) }, 5, &split_data,
+                           __builtin_offsetof(SetRevenueSplitInstructionData, revenue_split.recipients) +
+                           sizeof(RevenueSplitRecipient)));
+    check("sweep_revenue_split_set", manager_account.data_len == MANAGER_STATE_SWEEP_END,
+          "manager account size changed");
+
+    user_lamports = user.lamports;
+    uint64_t split_recipient_lamports = split_recipient.lamports;
+
+    assert_success("sweep_revenue_split",
+                   EXECUTE(sweep_data, W(manager_account), W(vote_account), W(user), R(vote_program),
+                           W(split_recipient)));
+    check("sweep_revenue_split", split_recipient.lamports == (split_recipient_lamports + 1000000000ul),
+          "revenue split recipient not paid its share");
+    check("sweep_revenue_split", user.lamports == (user_lamports + 1000000000ul), "sweep recipient not paid the rest");
+
+    // Disabling
+    data.recipient = system_program.key;
+    assert_success("sweep_disable", SET_SWEEP(rewards_authority));
+    vote_account.lamports += 3000000000ul;
+    assert_fail("sweep_disabled", Error_SweepNotSet,
+                EXECUTE(sweep_data, W(manager_account), W(vote_account), W(user), R(vote_program),
+                        W(split_recipient)));
+
+#undef SET_SWEEP
+}
+
+
+static void test_commission_schedule()
+{
+    setup();
+
+    enter_and_set_authorities("commission_schedule", true, 10, 2);
+
+    // Ramp the commission from 0 to 6 over three epochs, starting in the next epoch
+    uint64_t epoch = host_runtime.epoch;
+    SetCommissionScheduleInstructionData data = { Instruction_SetCommissionSchedule, 3,
+                                                  { { epoch + 1, 2 }, { epoch + 2, 4 }, { epoch + 3, 6 } } };
+    uint64_t data_len = __builtin_offsetof(SetCommissionScheduleInstructionData, steps) +
+        (3 * sizeof(CommissionScheduleStep));
+
+#define SET_COMMISSION_SCHEDULE(authority)                                                                            \
+    execute((HostAccountRef []) { W(manager_account), R(vote_account), S(authority), WS(admin), R(system_program) },  \
+            5, &data, data_len)
+
+    uint8_t apply_data = Instruction_ApplyCommissionSchedule;
+
+#define APPLY_COMMISSION_SCHEDULE() EXECUTE(apply_data, W(manager_account), W(vote_account), R(vote_program))
+
+    assert_fail("commission_schedule_not_set", Error_CommissionScheduleStepNotDue, APPLY_COMMISSION_SCHEDULE());
+
+    assert_fail("commission_schedule_invalid_rewards_authority", Error_InvalidAccount_First + 2,
+                SET_COMMISSION_SCHEDULE(admin));
+
+    data_len++;
+    assert_fail("commission_schedule_long_data", Error_InvalidDataSize, SET_COMMISSION_SCHEDULE(rewards_authority));
+    data_len--;
+
+    data.steps[0].epoch = epoch - 1;
+    assert_fail("commission_schedule_past_epoch", Error_InvalidCommissionSchedule,
+                SET_COMMISSION_SCHEDULE(rewards_authority));
+    data.steps[0].epoch = epoch + 2;
+    assert_fail("commission_schedule_epochs_not_increasing", Error_InvalidCommissionSchedule,
+                SET_COMMISSION_SCHEDULE(rewards_authority));
+    data.steps[0].epoch = epoch + 1;
+
+    data.steps[2].commission = 7;
+    assert_fail("commission_schedule_change_too_large", Error_CommissionChangeTooLarge,
+                SET_COMMISSION_SCHEDULE(rewards_authority));
+    data.steps[2].commission = 11;
+    assert_fail("commission_schedule_too_large", Error_CommissionTooLarge,
+                SET_COMMISSION_SCHEDULE(rewards_authority));
+    data.steps[2].commission = 6;
+
+    assert_success("commission_schedule_set", SET_COMMISSION_SCHEDULE(rewards_authority));
+    check("commission_schedule_set", manager_account.data_len == MANAGER_STATE_COMMISSION_SCHEDULE_END,
+          "manager account was not grown");
+    check("commission_schedule_set",
+          manager_account.lamports == rent_exempt_minimum(MANAGER_STATE_COMMISSION_SCHEDULE_END),
+          "manager account not funded to rent exempt minimum");
+
+    // Nothing is due in the current epoch
+    assert_fail("commission_schedule_not_due", Error_CommissionScheduleStepNotDue, APPLY_COMMISSION_SCHEDULE());
+
+    host_runtime.epoch++;
+    assert_success("commission_schedule_apply_1", APPLY_COMMISSION_SCHEDULE());
+    check("commission_schedule_apply_1", vote_account_commission() == 2, "commission not set");
+    assert_fail("commission_schedule_apply_1_again", Error_CommissionScheduleStepNotDue, APPLY_COMMISSION_SCHEDULE());
+
+    // A step that was missed in its epoch is applied late, and the steps after it in turn
+    host_runtime.epoch += 2;
+    assert_success("commission_schedule_apply_2", APPLY_COMMISSION_SCHEDULE());
+    check("commission_schedule_apply_2", vote_account_commission() == 4, "commission not set");
+
+    // The caps are enforced again when the step is applied
+    assert_fail("commission_schedule_apply_3_change_too_large", Error_CommissionChangeTooLarge,
+                APPLY_COMMISSION_SCHEDULE());
+    host_runtime.epoch++;
+    assert_success("commission_schedule_apply_3", APPLY_COMMISSION_SCHEDULE());
+    check("commission_schedule_apply_3", vote_account_commission() == 6, "commission not set");
+
+    assert_fail("commission_schedule_done", Error_CommissionScheduleStepNotDue, APPLY_COMMISSION_SCHEDULE());
+
+    // A step that the caps would reject in every later epoch, because a SetCommission has since lowered the commission
+    // too far below it, is skipped rather than blocking the steps after it
+    data.steps[0] = (CommissionScheduleStep) { host_runtime.epoch + 1, 8 };
+    data.steps[1] = (CommissionScheduleStep) { host_runtime.epoch + 2, 4 };
+    data.step_count = 2;
+    data_len = __builtin_offsetof(SetCommissionScheduleInstructionData, steps) + (2 * sizeof(CommissionScheduleStep));
+    assert_success("commission_schedule_rejected_set", SET_COMMISSION_SCHEDULE(rewards_authority));
+    assert_success("commission_schedule_rejected_lower", set_commission(&rewards_authority, 2));
+
+    host_runtime.epoch++;
+    assert_success("commission_schedule_rejected_skip", APPLY_COMMISSION_SCHEDULE());
+    check("commission_schedule_rejected_skip", vote_account_commission() == 2, "rejected step was applied");
+    check_commission_return_data("commission_schedule_rejected_skip", 2, 4);
+    check_event("commission_schedule_rejected_skip", Instruction_ApplyCommissionSchedule, 0, &(data.steps[0]),
+                sizeof(CommissionScheduleStep), 0, 0);
+    assert_fail("commission_schedule_rejected_skip_again", Error_CommissionScheduleStepNotDue,
+                APPLY_COMMISSION_SCHEDULE());
+
+    host_runtime.epoch++;
+    assert_success("commission_schedule_rejected_next", APPLY_COMMISSION_SCHEDULE());
+    check("commission_schedule_rejected_next", vote_account_commission() == 4, "commission not set");
+
+    // A new schedule is checked against the commission at the time that it is set
+    data.steps[0].epoch = host_runtime.epoch;
+    data.steps[0].commission = 9;
+    data.step_count = 1;
+    data_len = __builtin_offsetof(SetCommissionScheduleInstructionData, steps) + sizeof(CommissionScheduleStep);
+    assert_fail("commission_schedule_from_current_too_large", Error_CommissionChangeTooLarge,
+                SET_COMMISSION_SCHEDULE(rewards_authority));
+
+    // Removing the schedule
+    data.step_count = 0;
+    data_len = __builtin_offsetof(SetCommissionScheduleInstructionData, steps);
+    assert_success("commission_schedule_remove", SET_COMMISSION_SCHEDULE(rewards_authority));
+    assert_fail("commission_schedule_removed", Error_CommissionScheduleStepNotDue, APPLY_COMMISSION_SCHEDULE());
+
+    // No schedule may be set once a leave epoch is set
+    assert_success("commission_schedule_set_leave_epoch", set_leave_epoch(&withdrawer, host_runtime.epoch + 2));
+    data.steps[0].commission = 7;
+    data.step_count = 1;
+    data_len = __builtin_offsetof(SetCommissionScheduleInstructionData, steps) + sizeof(CommissionScheduleStep);
+    assert_fail("commission_schedule_leave_epoch_set", Error_LeaveEpochAlreadySet,
+                SET_COMMISSION_SCHEDULE(rewards_authority));
+
+#undef APPLY_COMMISSION_SCHEDULE
+#undef SET_COMMISSION_SCHEDULE
+}
+
+
+static void test_get_state()
+{
+    setup();
+
+    enter_and_set_authorities("get_state", true, 50, 2);
+
+    uint8_t data = Instruction_GetState;
+
+    assert_fail("get_state_long_data", Error_InvalidDataSize,
+                execute((HostAccountRef []) { R(manager_account), R(vote_account) }, 2, &data, 2));
+
+    vote_account.data[HOST_VOTE_COMMISSION_OFFSET] = 3;
+    vote_account.lamports += 5000000000ul;
+
+    const GetStateReturnData *return_data = (const GetStateReturnData *) host_runtime.return_data;
+
+    host_runtime.log_data_count = 0;
+
+    assert_success("get_state_success", EXECUTE(data, R(manager_account), R(vote_account)));
+    check("get_state_success", host_runtime.return_data_len == sizeof(GetStateReturnData),
+          "incorrect return data size");
+    check("get_state_success", !memcmp(&(return_data->state), manager_state(), sizeof(VoteAccountManagerState)),
+          "incorrect state");
+    check("get_state_success", return_data->epoch == host_runtime.epoch, "incorrect epoch");
+    check("get_state_success", return_data->vote_account_lamports == vote_account.lamports,
+          "incorrect vote account lamports");
+    check("get_state_success", return_data->withdrawable_lamports ==
+          (vote_account.lamports - rent_exempt_minimum(HOST_VOTE_ACCOUNT_SIZE)), "incorrect withdrawable lamports");
+    check("get_state_success", (return_data->commission == 3) && (return_data->max_allowed_commission == 5),
+          "incorrect commission");
+    check("get_state_success", host_runtime.log_data_count == 0, "event logged");
+
+    // The optional sections of the manager account follow
+    SetSweepInstructionData set_sweep_data = { Instruction_SetSweep, user.key, 1 };
+    assert_success("get_state_setup", EXECUTE(set_sweep_data, W(manager_account), R(vote_account),
+                                              S(rewards_authority), WS(admin), R(system_program)));
+
+    assert_success("get_state_sections", EXECUTE(data, R(manager_account), R(vote_account)));
+    check("get_state_sections", host_runtime.return_data_len ==
+          (sizeof(GetStateReturnData) + (MANAGER_STATE_SWEEP_END - MANAGER_STATE_SIZE)), "incorrect return data size");
+    check("get_state_sections", !memcmp(&(host_runtime.return_data[sizeof(GetStateReturnData)]),
+                                        &(manager_account.data[MANAGER_STATE_SIZE]),
+                                        MANAGER_STATE_SWEEP_END - MANAGER_STATE_SIZE), "incorrect sections");
+
+    // Once the leave epoch is set, the commission cannot be changed
+    assert_success("get_state_setup_2", set_leave_epoch(&withdrawer, host_runtime.epoch + 2));
+    assert_success("get_state_leave_epoch_set", EXECUTE(data, R(manager_account), R(vote_account)));
+    check("get_state_leave_epoch_set", return_data->max_allowed_commission == 3, "incorrect max allowed commission");
+}
+
+
+// The runtime's rent exempt minimum computation, Rent::minimum_balance(), using host f64 arithmetic, with Rust's
+// saturating f64 to u64 conversion
+static uint64_t runtime_minimum_balance(uint64_t lamports_per_byte_year, double exemption_threshold,
+                                        uint64_t account_size)
+{
+    double result = ((double) ((account_size + 128) * lamports_per_byte_year)) * exemption_threshold;
+
+    if (!(result > 0)) {
+        return 0;
+    }
+
+    if (result >= 18446744073709551616.0) {
+        return UINT64_MAX;
+    }
+
+    return (uint64_t) result;
+}
+
+
+// Returns deterministic pseudo-random values
+static uint64_t next_random()
+{
+    static uint64_t x = 0x9E3779B97F4A7C15ul;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return x;
+}
+
+
+static void test_rent_exempt_minimum()
+{
+    setup();
+
+    double thresholds[] = { 2.0, 1.0, 0.5, 1.5, 2.5, 3.0, 0.1, 1.0 / 3.0, 1e-300, 1e300, 0.0, -2.0, 1e-310 };
+    uint64_t sizes[] = { 0, 1, 168, 3731, 3762, 10240, 10 * 1024 * 1024 };
+    uint64_t lamports_per_byte_years[] = { 0, 1, 3480, 1000000, 1ul << 40 };
+
+    for (uint64_t t = 0; t < ARRAY_LEN(thresholds); t++) {
+        for (uint64_t s = 0; s < ARRAY_LEN(sizes); s++) {
+            for (uint64_t l = 0; l < ARRAY_LEN(lamports_per_byte_years); l++) {
+                Rent rent = { lamports_per_byte_years[l], 0, 0 };
+                memcpy(&(rent.exemption_threshold), &(thresholds[t]), sizeof(double));
+                if (compute_rent_exempt_minimum(&rent, sizes[s]) !=
+                    runtime_minimum_balance(lamports_per_byte_years[l], thresholds[t], sizes[s])) {
+                    printf("FAIL: rent_exempt_minimum: mismatch for threshold %g, size %lu, lamports %lu\n",
+                           thresholds[t], sizes[s], lamports_per_byte_years[l]);
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    // Random thresholds between 2^-8 and 2^8, and random sizes and lamports per byte year, including products that
+    // exceed 2^53 and so must be rounded when converted to f64
+    for (uint64_t i = 0; i < 1000000; i++) {
+        uint64_t threshold_bits = (next_random() & 0x000FFFFFFFFFFFFFul) | ((1015 + (next_random() % 16)) << 52);
+        double threshold;
+        memcpy(&threshold, &threshold_bits, sizeof(threshold));
+        uint64_t size = next_random() % (20 * 1024 * 1024);
+        uint64_t shift = 20 + (next_random() % 44);
+        uint64_t lamports_per_byte_year = next_random() >> shift;
+        Rent rent = { lamports_per_byte_year, threshold_bits, 0 };
+        if (compute_rent_exempt_minimum(&rent, size) != runtime_minimum_balance(lamports_per_byte_year, threshold,
+                                                                                 size)) {
+            printf("FAIL: rent_exempt_minimum: mismatch for threshold %.17g, size %lu, lamports %lu\n", threshold,
+                   size, lamports_per_byte_year);
+            exit(1);
+        }
+    }
+
+    printf("+ rent_exempt_minimum\n");
+
+    // The default values used when the Rent sysvar cannot be fetched
+    check("rent_exempt_minimum_default", compute_rent_exempt_minimum(0, 3762) == 27074400,
+          "incorrect default rent exempt minimum");
+
+    // The vote account's actual size is used
+    setup();
+    enter_and_set_authorities("rent_exempt_minimum_vote_account_size", false, 0, 0);
+    vote_account.data_len = 3731;
+    vote_account.lamports += 1000000000ul;
+    assert_success("rent_exempt_minimum_vote_account_size", withdraw(&rewards_authority, 0));
+    check("rent_exempt_minimum_vote_account_size", vote_account.lamports == (3731 + 128) * 3480 * 2,
+          "vote account was not reduced to rent exempt minimum");
+}
+
+
+// Benchmarks ---------------------------------------------------------------------------------------------------------
+
+// Runs an instruction count times on a single serialized input and reports the rate.  Instructions that change state
+// in a way that would make the next run behave differently restore the input from a pristine copy before each run,
+// and the time to do so is included in the result.
+static void bench(const char *name, uint64_t count, const HostAccountRef *accounts, int account_count,
+                  const void *data, uint64_t data_len, bool restore)
+{
+    uint64_t size;
+    uint8_t *pristine = host_serialize(accounts, account_count, data, data_len, &size);
+    uint8_t *input = host_serialize(accounts, account_count, data, data_len, &size);
+
+    struct timespec start, end;
+
+    uint64_t expected = entrypoint(input);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (restore) {
+            memcpy(input, pristine, size);
+        }
+        if (entrypoint(input) != expected) {
+            printf("FAIL: bench %s: result changed on iteration %lu\n", name, i);
+            exit(1);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+
+    printf("%-28s %10.1f ns/instruction %12.0f instructions/sec%s\n", name, (seconds * 1e9) / count, count / seconds,
+           restore ? " (includes input restore)" : "");
+
+    free(input);
+    free(pristine);
+}
+
+
+#define BENCH(name, count, restore, data, ...)                                                                        \
+    bench(name, count, (HostAccountRef []) { __VA_ARGS__ },                                                           \
+          sizeof((HostAccountRef []) { __VA_ARGS__ }) / sizeof(HostAccountRef), &(data), sizeof(data), restore)
+
+static void run_benchmarks(uint64_t count)
+{
+    setup();
+
+    EnterInstructionData enter_data = { Instruction_Enter, admin.key, true, 10, 2 };
+    BENCH("enter", count, true, enter_data, W(manager_account), W(vote_account), WS(withdrawer), S(withdrawer),
+          R(system_program), R(vote_program), R(clock_sysvar));
+
+    enter_and_set_authorities("bench", true, 100, 100);
+
+    vote_account.lamports += 1000000000000000ul;
+
+    SetLeaveEpochInstructionData set_leave_epoch_data = { Instruction_SetLeaveEpoch, 1000 };
+    BENCH("set_leave_epoch", count, true, set_leave_epoch_data, W(manager_account), R(vote_account),
+          S(withdrawer));
+
+    SetAuthorityInstructionData set_administrator_data = { Instruction_SetAdministrator, admin.key };
+    BENCH("set_administrator", count, false, set_administrator_data, W(manager_account), R(vote_account),
+          S(withdrawer));
+
+    SetAuthorityInstructionData set_operational_authority_data = { Instruction_SetOperationalAuthority,
+                                                                   operational_authority.key };
+    BENCH("set_operational_authority", count, false, set_operational_authority_data, W(manager_account),
+          R(vote_account), S(admin));
+
+    SetAuthorityInstructionData set_rewards_authority_data = { Instruction_SetRewardsAuthority,
+                                                               rewards_authority.key };
+    BENCH("set_rewards_authority", count, false, set_rewards_authority_data, W(manager_account), R(vote_account),
+          S(admin));
+
+    SetAuthorityInstructionData set_vote_authority_data = { Instruction_SetVoteAuthority, user.key };
+    BENCH("set_vote_authority", count, false, set_vote_authority_data, R(manager_account), W(vote_account),
+          S(operational_authority), R(vote_program), R(clock_sysvar));
+
+    uint8_t set_validator_identity_data = Instruction_SetValidatorIdentity;
+    BENCH("set_validator_identity", count, false, set_validator_identity_data, R(manager_account), W(vote_account),
+          S(operational_authority), S(new_validator_identity), R(vote_program));
+
+    WithdrawInstructionData withdraw_data = { Instruction_Withdraw, 1 };
+    BENCH("withdraw", count, false, withdraw_data, R(manager_account), W(vote_account), S(rewards_authority), W(user),
+          R(vote_program));
+
+    SetCommissionInstructionData set_commission_data = { Instruction_SetCommission, 5 };
+    BENCH("set_commission", count, false, set_commission_data, W(manager_account), W(vote_account),
+          S(rewards_authority), R(vote_program));
+
+    uint8_t leave_data = Instruction_Leave;
+    manager_account.data[offsetof(VoteAccountManagerState, use_commission_caps)] = false;
+    BENCH("leave", count, true, leave_data, W(manager_account), W(vote_account), S(withdrawer), W(user),
+          R(vote_program), R(clock_sysvar));
+
+    uint8_t batch_data[64] = { Instruction_Batch, 2 };
+    uint64_t batch_data_len = sizeof(BatchInstructionData);
+    uint8_t batch_withdraw_indices[] = { 0, 1, 4, 5, 7 };
+    batch_add(batch_data, &batch_data_len, batch_withdraw_indices, 5, &withdraw_data, sizeof(withdraw_data));
+    uint8_t batch_set_commission_indices[] = { 0, 1, 4, 7 };
+    batch_add(batch_data, &batch_data_len, batch_set_commission_indices, 4, &set_commission_data,
+              sizeof(set_commission_data));
+    HostAccountRef batch_accounts[] = { BATCH_ACCOUNTS };
+    bench("batch_withdraw_set_commission", count, batch_accounts, ARRAY_LEN(batch_accounts), batch_data,
+          batch_data_len, false);
+
+    uint8_t get_state_data = Instruction_GetState;
+    BENCH("get_state", count, false, get_state_data, R(manager_account), R(vote_account));
+
+    uint8_t unknown_data = 200;
+    BENCH("unknown_instruction", count, false, unknown_data, W(manager_account), W(vote_account));
+}
+
+
+int main(int argc, char **argv)
+{
+    if ((argc > 1) && !strcmp(argv[1], "bench")) {
+        run_benchmarks((argc > 2) ? strtoull(argv[2], 0, 10) : 1000000);
+        return 0;
+    }
+
+    test_entrypoint();
+    test_pubkey_helpers();
+    test_enter();
+    test_bump_seed();
+    test_manager_state_layout();
+    test_vote_state_versions();
+    test_set_leave_epoch();
+    test_leave();
+    test_set_authorities();
+    test_set_validator_identity();
+    test_withdraw();
+    test_set_commission();
+    test_batch();
+    test_fleet();
+    test_revenue_split();
+    test_sweep();
+    test_commission_schedule();
+    test_get_state();
+    test_rent_exempt_minimum();
+
+    printf("All tests passed\n");
+
+    return 0;
+}
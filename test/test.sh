@@ -298,6 +298,15 @@ source $SOURCE/test/test_set_vote_authority
 source $SOURCE/test/test_set_validator_identity
 source $SOURCE/test/test_withdraw
 source $SOURCE/test/test_set_commission
+source $SOURCE/test/test_revenue_split
+source $SOURCE/test/test_sweep
+source $SOURCE/test/test_commission_schedule
+source $SOURCE/test/test_batch
+source $SOURCE/test/test_fleet
+source $SOURCE/test/test_lookup_table
+source $SOURCE/test/test_vamp_batch
+source $SOURCE/test/test_vamp_index
+source $SOURCE/test/test_compute_budget
 
 
 # Tear down